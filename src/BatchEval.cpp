@@ -0,0 +1,87 @@
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include "Driver.h"
+#include "Timer.h"
+
+void Driver::batchEvaluate(const std::string &networkPath,
+                           const std::string &inputPath,
+                           const std::string &outputPath,
+                           int threads) {
+    // positions are read, evaluated and written in chunks to keep memory bounded
+    const int chunkSize = 1 << 16;
+
+    auto nnue = NNUE::loadNetwork(networkPath);
+    if (!nnue) {
+        return;
+    }
+
+    std::ifstream input(inputPath);
+    std::ofstream output(outputPath);
+    if (!input || !output) {
+        std::cout << "Could not open " << (!input ? inputPath : outputPath) << std::endl;
+        return;
+    }
+
+    std::vector<std::string> fens;
+    std::vector<NNUE::NetworkInput> inputs(chunkSize);
+    std::vector<int> evals(chunkSize);
+    long long total = 0;
+
+    Timer timer;
+    timer.start();
+
+    while (true) {
+        fens.clear();
+        std::string line;
+        while ((int) fens.size() < chunkSize && std::getline(input, line)) {
+            if (!line.empty()) fens.push_back(line);
+        }
+        if (fens.empty()) break;
+
+        int count = (int) fens.size();
+        int sliceSize = (count + threads - 1) / threads;
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            int begin = t * sliceSize;
+            int end = std::min(count, begin + sliceSize);
+            if (begin >= end) break;
+
+            workers.emplace_back([&, begin, end] {
+                for (int i = begin; i < end; i++) {
+                    Board board = Board::fromFen(fens[i]);
+                    inputs[i] = networkInputFromBoard(board);
+                }
+                nnue->evaluateBatch(&inputs[begin], end - begin, &evals[begin]);
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        for (int i = 0; i < count; i++) {
+            output << fens[i] << ";" << evals[i] << "\n";
+        }
+        total += count;
+    }
+
+    timer.end();
+
+    std::cout << "===== Batch evaluation of " << inputPath << " (" << nnue->architecture() << ") =====" << std::endl;
+    std::cout << "evaluated " << total << " positions with " << threads << " threads in " << timer.getSeconds() << " s. ";
+    std::cout << std::fixed << "speed: " << std::setprecision(0) << total / timer.getSeconds() << " positions/s"
+              << std::endl;
+}
+
+NNUE::NetworkInput Driver::networkInputFromBoard(const Board &board) {
+    NNUE::NetworkInput input;
+    for (int color : {WHITE, BLACK}) {
+        for (int piece : PieceTypes) {
+            for (int i = 0; i < board.pieceCounts[color][piece]; i++) {
+                input.addPiece(board.pieces[color][piece][i], piece, color, board.moveColor);
+            }
+        }
+    }
+    return input;
+}
@@ -0,0 +1,114 @@
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "Driver.h"
+#include "Config.h"
+#include "PerfCounters.h"
+#include "Positions.h"
+#include "Timer.h"
+
+void Driver::bench(int depth, int threads, int hashMegabytes, const std::string &networkPath) {
+    // the network given, otherwise the embedded one or the NNUEPath default
+    std::unique_ptr<NNUE::Network> network;
+    std::string savedNnuePath = Config::nnuePath;
+    if (!networkPath.empty()) {
+        network = NNUE::loadNetwork(networkPath);
+    } else if (!Config::nnuePath.empty()) {
+        network = loadNetwork();
+    }
+    Config::nnuePath = savedNnuePath;
+
+    int savedThreads = Config::threads;
+    int savedHash = Config::transpositionTableSize;
+    Config::threads = threads;
+    Config::transpositionTableSize = hashMegabytes;
+
+    {
+        // opened before the search starts its threads, so that they are counted too
+        PerfCounters counters;
+        Search search;
+
+        // commands run in order on the search worker, so this returns once everything queued is done
+        auto waitForSearch = [&search] {
+            std::promise<void> done;
+            search.post([&done] { done.set_value(); });
+            done.get_future().wait();
+        };
+
+        std::cout << "===== Bench depth " << depth << ", " << threads << " thread(s), " << hashMegabytes
+                  << " MB hash, " << TEST_POSITIONS.size() << " positions =====" << std::endl;
+
+        for (bool useNnue : {false, true}) {
+            NNUE::Network *nnue = useNnue ? network.get() : nullptr;
+            if (useNnue && !nnue) {
+                continue;
+            }
+            std::string mode = useNnue ? "NNUE" : "HCE";
+
+            long long totalNodes = 0;
+            double totalSeconds = 0;
+            uint64_t signature = 0xcbf29ce484222325ULL; // FNV-1a over the node count of every position
+            counters.reset();
+
+            for (int i = 0; i < (int) TEST_POSITIONS.size(); i++) {
+                Board board = Board::fromFen(TEST_POSITIONS[i]);
+
+                // every position starts from an empty table and history, as after ucinewgame
+                search.post([&search] {
+                    search.resetCache();
+                    search.tTable.wait();
+                });
+                waitForSearch();
+
+                SearchParams params{};
+                params.depthLimit = depth;
+
+                // only the totals are printed, the search's own info lines are dropped
+                std::ostringstream discarded;
+                auto *console = std::cout.rdbuf(discarded.rdbuf());
+
+                Timer timer;
+                counters.start();
+                timer.start();
+                search.go(params, [&search, &board, nnue]() {
+                    board.nnue = nnue;
+                    if (nnue) {
+                        initNnueFromBoard(board, *nnue);
+                    }
+                    search.setBoard(board);
+                });
+                waitForSearch();
+                timer.end();
+                counters.stop();
+
+                std::cout.rdbuf(console);
+
+                long long nodes = search.nodesSearched();
+                totalNodes += nodes;
+                totalSeconds += timer.getSeconds();
+                for (int byte = 0; byte < 8; byte++) {
+                    signature = (signature ^ ((nodes >> (8 * byte)) & 0xFF)) * 0x100000001b3ULL;
+                }
+
+                std::cout << mode << " position " << std::setw(2) << i + 1 << ": " << nodes << " nodes" << std::endl;
+            }
+
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << mode << ": nodes " << totalNodes << ", time " << totalSeconds << " s, nps "
+                      << (long long) (totalNodes / totalSeconds) << ", signature " << std::hex << signature
+                      << std::dec << std::endl;
+            counters.report(std::cout, mode, totalNodes);
+        }
+
+        if (!network) {
+            std::cout << "NNUE: skipped, no network (embed one or pass a path as the fourth argument)" << std::endl;
+        }
+        if (threads > 1) {
+            std::cout << "node counts and signatures only repeat with 1 thread" << std::endl;
+        }
+    }
+
+    Config::threads = savedThreads;
+    Config::transpositionTableSize = savedHash;
+}
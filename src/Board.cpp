@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <tuple>
 #include <functional>
 #include "Board.h"
@@ -32,10 +33,8 @@ Board::Board(const BoardArray &board,
     zobristKey.flipCastlingRights(BLACK, castling_rights[BLACK]);
     setEnPassantSquare(en_passant_square);
 
-    moveHistory.reserve(256);
-    captureHistory.reserve(64);
-
-    precalculateAttackTable();
+    static const bool attackTableReady = (precalculateAttackTable(), true);
+    (void) attackTableReady;
 }
 void Board::precalculateAttackTable() {
     for (int distance = 1; distance <= 7; distance++) {
@@ -56,13 +55,12 @@ void Board::precalculateAttackTable() {
     }
 }
 
-void Board::makeMove(const Move &move) {
-    auto moveInfo = MoveInfo(move,
-                             0,
-                             enPassantSquare,
-                             numHalfMoves,
-                             castlingRights,
-                             0);
+void Board::makeMove(const Move &move, UndoInfo &undo) {
+    undo.move = move;
+    undo.numCaptured = 0;
+    undo.prevEnPassant = enPassantSquare;
+    undo.prevNumHalfMoves = numHalfMoves;
+    undo.previousCastlingRights = castlingRights;
 
     //update castling rights
     if (board[move.from].type() == KING) {
@@ -93,14 +91,12 @@ void Board::makeMove(const Move &move) {
 
     //perform capture
     if (move.flags & MoveFlags::CAPTURE) {
-        moveInfo.numCaptured = 2;
-
         int capturedIdx = !(move.flags & MoveFlags::EN_PASSANT_CAPTURE)
                           ? move.to
                           : move.to + (moveColor == WHITE ? Direction::DOWN : Direction::UP);
 
-        captureHistory.emplace_back(move.from, board[move.from]);
-        captureHistory.emplace_back(capturedIdx, board[capturedIdx]);
+        undo.captured[undo.numCaptured++] = {move.from, board[move.from]};
+        undo.captured[undo.numCaptured++] = {capturedIdx, board[capturedIdx]};
 
         removePiece(capturedIdx, true, false);
         removePiece(move.from, false, false);
@@ -108,8 +104,7 @@ void Board::makeMove(const Move &move) {
         for (int direction : explosionDirections) {
             int idx = move.to + direction;
             if (Board::inBounds(idx) && !isEmpty(idx) && board[idx].type() != PieceType::PAWN) {
-                moveInfo.numCaptured++;
-                captureHistory.emplace_back(idx, board[idx]);
+                undo.captured[undo.numCaptured++] = {idx, board[idx]};
                 removePiece(idx, true, false);
             }
         }
@@ -160,19 +155,140 @@ void Board::makeMove(const Move &move) {
     flipMoveColor();
 
     //for undo
-    moveInfo.zobristKey = zobristKey.value;
-    moveHistory.push_back(moveInfo);
+    undo.zobristKey = zobristKey.value;
+    undo.previous = lastMove;
+    lastMove = &undo;
 
     if(nnue){
-        nnue->accumulator.increaseDepth();
-        nnue->accumulator.applyStagedChanges();
+        nnue->increaseDepth();
+        nnue->applyStagedChanges();
     }
 
 }
 
+// zobrist key makeMove would produce, explosions included, without touching the board
+uint64_t Board::keyAfter(const Move &move) const {
+    ZobristKey key = zobristKey;
+    auto rights = castlingRights;
+    Piece mover = board[move.from];
+
+    auto removeRookRights = [&](int idx) {
+        if (board[idx].type() != ROOK) return;
+        if (idx == positionToIndex(0, 0)) rights[WHITE] &= ~CastlingRight::QUEEN_SIDE;
+        if (idx == positionToIndex(0, 7)) rights[BLACK] &= ~CastlingRight::QUEEN_SIDE;
+        if (idx == positionToIndex(7, 0)) rights[WHITE] &= ~CastlingRight::KING_SIDE;
+        if (idx == positionToIndex(7, 7)) rights[BLACK] &= ~CastlingRight::KING_SIDE;
+    };
+
+    //castling rights of the moving side
+    if (mover.type() == KING) {
+        rights[moveColor] = NO_CASTLE;
+    }
+    if (indexToFile(move.from) == 0 && mover.type() == ROOK) {
+        rights[moveColor] &= ~CastlingRight::QUEEN_SIDE;
+    }
+    if (indexToFile(move.from) == 7 && mover.type() == ROOK) {
+        rights[moveColor] &= ~CastlingRight::KING_SIDE;
+    }
+
+    //en passant
+    if (enPassantSquare != -1) {
+        key.flipEnPassantFile(indexToFile(enPassantSquare));
+    }
+    if (move.flags & MoveFlags::DOUBLE_PAWN) {
+        key.flipEnPassantFile(indexToFile(move.to));
+    }
+
+    //capture and explosion
+    if (move.flags & MoveFlags::CAPTURE) {
+        int capturedIdx = !(move.flags & MoveFlags::EN_PASSANT_CAPTURE)
+                          ? move.to
+                          : move.to + (moveColor == WHITE ? Direction::DOWN : Direction::UP);
+
+        key.flipPiece(capturedIdx, board[capturedIdx]);
+        removeRookRights(capturedIdx);
+        key.flipPiece(move.from, mover);
+
+        for (int direction : explosionDirections) {
+            int idx = move.to + direction;
+            if (Board::inBounds(idx) && idx != move.from && idx != capturedIdx
+                && !isEmpty(idx) && board[idx].type() != PieceType::PAWN) {
+                key.flipPiece(idx, board[idx]);
+                removeRookRights(idx);
+            }
+        }
+    }
+
+    //promotion
+    if (move.flags & MoveFlags::PROMOTION_SUBMASK) {
+        if (move.flags & MoveFlags::CAPTURE) {
+            key.flipPiece(move.to, Piece());
+        } else {
+            key.flipPiece(move.from, mover);
+        }
+
+        int pieceType;
+        if (move.flags & MoveFlags::KNIGHT_PROMOTION)
+            pieceType = KNIGHT;
+        if (move.flags & MoveFlags::BISHOP_PROMOTION)
+            pieceType = BISHOP;
+        if (move.flags & MoveFlags::QUEEN_PROMOTION)
+            pieceType = QUEEN;
+        if (move.flags & MoveFlags::ROOK_PROMOTION)
+            pieceType = ROOK;
+        if (moveColor == BLACK) {
+            pieceType |= BLACK_FLAG;
+        }
+        key.flipPiece(move.to, Piece(pieceType, -1));
+    }
+
+    //castling
+    if (move.flags & MoveFlags::CASTLE_SUBMASK) {
+        int rookFrom = positionToIndex(move.flags & MoveFlags::CASTLE_LEFT ? 0 : 7, indexToRank(move.to));
+        int rookTo = move.to + (move.flags & MoveFlags::CASTLE_LEFT ? Direction::RIGHT : Direction::LEFT);
+        key.flipPiece(move.from, mover);
+        key.flipPiece(move.to, mover);
+        key.flipPiece(rookFrom, board[rookFrom]);
+        key.flipPiece(rookTo, board[rookFrom]);
+        rights[moveColor] = NO_CASTLE;
+    }
+
+    //quiet move
+    if ((move.flags & ~(MoveFlags::DOUBLE_PAWN | MoveFlags::PAWN_MOVE)) == 0 && !(move.flags & MoveFlags::NULL_MOVE)) {
+        key.flipPiece(move.from, mover);
+        key.flipPiece(move.to, mover);
+    }
+
+    for (int color : {WHITE, BLACK}) {
+        if (rights[color] != castlingRights[color]) {
+            key.flipCastlingRights(color, castlingRights[color]);
+            key.flipCastlingRights(color, rights[color]);
+        }
+    }
+    key.flipMoveColor();
+
+    return key.value;
+}
+
+void Board::playMove(const Move &move) {
+    UndoInfo undo;
+    makeMove(move, undo);
+    lastMove = undo.previous;
+
+    if (move.flags & MoveFlags::NON_REPEATABLE_MASK) {
+        gameKeyCount = 0;
+        return;
+    }
+    if (gameKeyCount == (int) gameKeys.size()) {
+        std::copy(gameKeys.begin() + 1, gameKeys.end(), gameKeys.begin());
+        gameKeyCount--;
+    }
+    gameKeys[gameKeyCount++] = zobristKey.value;
+}
+
 void Board::unmakeMove() {
-    auto lastMoveUndo = moveHistory.back();
-    moveHistory.pop_back();
+    const UndoInfo &lastMoveUndo = *lastMove;
+    lastMove = lastMoveUndo.previous;
 
     //restore game state
     flipMoveColor();
@@ -185,9 +301,8 @@ void Board::unmakeMove() {
 
     //restore captures
     if (move.flags & MoveFlags::CAPTURE) {
-        for (int i = 0; i < lastMoveUndo.numCaptured; i++) {
-            auto pieceToRestore = captureHistory.back();
-            captureHistory.pop_back();
+        for (int i = lastMoveUndo.numCaptured - 1; i >= 0; i--) {
+            auto pieceToRestore = lastMoveUndo.captured[i];
             addPiece(pieceToRestore.first, pieceToRestore.second, true);
         }
     }
@@ -222,7 +337,7 @@ void Board::unmakeMove() {
     }
 
     if(nnue){
-        nnue->accumulator.decreaseDepth();
+        nnue->decreaseDepth();
     }
 
 }
@@ -238,8 +353,8 @@ void Board::movePiece(int from, int to, bool unmake) {
     zobristKey.flipPiece(to, piece);
 
     if(!unmake && nnue){
-        nnue->accumulator.stageChange<false>(to, piece.type(), piece.color());
-        nnue->accumulator.stageChange<true>(from, piece.type(), piece.color());
+        nnue->stageChange<false>(to, piece.type(), piece.color());
+        nnue->stageChange<true>(from, piece.type(), piece.color());
     }
 }
 
@@ -254,7 +369,7 @@ void Board::addPiece(int idx, Piece piece, bool unmake) {
     zobristKey.flipPiece(idx, piece);
 
     if(!unmake && nnue){
-        nnue->accumulator.stageChange<false>(idx, piece.type(), piece.color());
+        nnue->stageChange<false>(idx, piece.type(), piece.color());
     }
 }
 
@@ -286,7 +401,7 @@ void Board::removePiece(int idx, bool capture, bool unmake) {
     board[idx] = Piece();
 
     if(!unmake && nnue){
-        nnue->accumulator.stageChange<true>(idx, piece.type(), piece.color());
+        nnue->stageChange<true>(idx, piece.type(), piece.color());
     }
 }
 
@@ -385,17 +500,21 @@ int Board::castRay(int startingSquare, int direction, int destination) const {
     return result;
 }
 bool Board::isRepetition() const {
-    uint64_t lastHash = moveHistory.back().zobristKey;
+    uint64_t lastHash = zobristKey.value;
     int seen = 0;
-    for (auto it = moveHistory.rbegin(); it != moveHistory.rend(); it = next(it)) {
-        auto move = *it;
-        if (move.move.flags & MoveFlags::NULL_MOVE) {
+    for (auto undo = lastMove; undo != nullptr; undo = undo->previous) {
+        if (undo->move.flags & MoveFlags::NULL_MOVE) {
             continue;
         }
-        if (move.move.flags & MoveFlags::NON_REPEATABLE_MASK) {
+        if (undo->move.flags & MoveFlags::NON_REPEATABLE_MASK) {
             return false;
         }
-        if (lastHash == move.zobristKey) {
+        if (lastHash == undo->zobristKey) {
+            if (++seen == 2) return true;
+        }
+    }
+    for (int i = gameKeyCount - 1; i >= 0; i--) {
+        if (lastHash == gameKeys[i]) {
             if (++seen == 2) return true;
         }
     }
@@ -417,8 +536,8 @@ std::string Board::moveToString(const Move &move) {
 
     return result;
 }
-bool Board::tryMakeMove(const Move &move) {
-    makeMove(move);
+bool Board::tryMakeMove(const Move &move, UndoInfo &undo) {
+    makeMove(move, undo);
     if(!isLegal()){
         unmakeMove();
         return false;
@@ -474,15 +593,17 @@ std::string Board::indexToString(int idx) {
     return {file, rank};
 }
 
-Board::MoveInfo::MoveInfo(const Move &move,
-                          int num_captured,
-                          int prev_en_passant,
-                          int prev_num_half_moves,
-                          const std::array<int, 2> &previous_castling_rights,
-                          uint64_t zobristKey)
-    : move(move),
-      numCaptured(num_captured),
-      prevEnPassant(prev_en_passant),
-      prevNumHalfMoves(prev_num_half_moves),
-      previousCastlingRights(previous_castling_rights),
-      zobristKey(zobristKey) {}
+void initNnueFromBoard(const Board &board, NNUE::Network &nnue) {
+    nnue.setDepth(0);
+    nnue.initAccumulator();
+    for (int color : {WHITE, BLACK}) {
+        for (int piece : PieceTypes) {
+            for (int i = 0; i < board.pieceCounts[color][piece]; i++) {
+                int pos = board.pieces[color][piece][i];
+                nnue.stageChange<false>(pos, piece, color);
+            }
+        }
+    }
+    nnue.applyStagedChanges(false);
+}
+
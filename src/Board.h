@@ -18,6 +18,18 @@ typedef std::array<std::array<int, 7>, 2> PieceCountArray;
 
 class Board {
  public:
+    // what unmakeMove needs, owned by the caller (a search stack frame) while the move is on the board
+    struct UndoInfo {
+        Move move;
+        int numCaptured;
+        int prevEnPassant;
+        int prevNumHalfMoves;
+        uint64_t zobristKey; // after the move
+        std::array<int, 2> previousCastlingRights;
+        std::array<std::pair<int, Piece>, 10> captured; // mover, captured piece and up to 8 exploded neighbours
+        const UndoInfo *previous;
+    };
+
     Board(const BoardArray &board,
           const PieceArray &pieces,
           const PieceCountArray &piece_counts,
@@ -42,17 +54,21 @@ class Board {
     ZobristKey zobristKey{};
 
     // NNUE
-    NNUE::NNUE *nnue = nullptr;
+    NNUE::Network *nnue = nullptr;
 
     // fen parsing stuff
     static Board fromFen(const std::string &fen);
     [[nodiscard]] std::string toFen() const;
 
-    // move making
-    void makeMove(const Move &move);
-    bool tryMakeMove(const Move &move);
+    // move making, undo has to stay alive until the move is unmade
+    void makeMove(const Move &move, UndoInfo &undo);
+    [[nodiscard]] uint64_t keyAfter(const Move &move) const;
+    bool tryMakeMove(const Move &move, UndoInfo &undo);
     void unmakeMove();
 
+    // a move of the game before the search, only remembered for repetitions and never unmade
+    void playMove(const Move &move);
+
     // state checks
     [[nodiscard]] bool isAttacked(int idx) const;
     [[nodiscard]] bool isLegal() const;
@@ -87,21 +103,6 @@ class Board {
 
 
  private:
-    struct MoveInfo {
-        MoveInfo(const Move &move,
-                 int num_captured,
-                 int prev_en_passant,
-                 int prev_num_half_moves,
-                 const std::array<int, 2> &previous_castling_rights,
-                 uint64_t zobristKey);
-        Move move;
-        int numCaptured{};
-        int prevEnPassant{};
-        int prevNumHalfMoves{};
-        uint64_t zobristKey{};
-        std::array<int, 2> previousCastlingRights{};
-    };
-
     // used in move making
     void addPiece(int idx, Piece piece, bool unmake);
     void removePiece(int idx, bool capture, bool unmake);
@@ -110,9 +111,12 @@ class Board {
     //fen parsing
     static std::tuple<BoardArray, PieceArray, PieceCountArray> extractPiecesFromFen(const std::string &fen);
 
-    //incremental update
-    std::vector<MoveInfo> moveHistory;
-    std::vector<std::pair<int, Piece>> captureHistory;
+    //incremental update, the moves made on top of the game, latest first
+    const UndoInfo *lastMove = nullptr;
+
+    //keys after the played game moves since the last one that can't be repeated (50 move rule bounds them)
+    std::array<uint64_t, 100> gameKeys{};
+    int gameKeyCount = 0;
 
     //move gen util stuff
     int castRay(int startingSquare, int direction, int destination) const;
@@ -122,6 +126,9 @@ class Board {
     bool isAttacked(int idx, bool inverseColor) const;
 
     //attacker check utils
-    std::array<std::array<int, 256>, 7> attackDirection{};
-    void precalculateAttackTable();
-};
\ No newline at end of file
+    static inline std::array<std::array<int, 256>, 7> attackDirection{};
+    static void precalculateAttackTable();
+};
+
+// accumulators of the network rebuilt from the board's pieces, at depth 0
+void initNnueFromBoard(const Board &board, NNUE::Network &nnue);
\ No newline at end of file
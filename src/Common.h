@@ -1,15 +1,32 @@
 #pragma once
 
 #include <array>
+#include <string>
 
 //engine params
 const bool USE_METRICS = true;
-const int MAX_DEPTH = 128;
-const int EVAL_MAX = 1e5;
+const int MAX_DEPTH = 128; // also the deepest ply
+const int MAX_MOVES = 256; // pseudo legal moves of one position, more only in composed positions with many queens
+const int EVAL_MAX = 30000; // fits the int16 values of the transposition table
 const int EVAL_MIN = -EVAL_MAX;
+const int MATE_BOUND = EVAL_MAX - MAX_DEPTH; // scores beyond are wins or losses, EVAL_MAX - plies to the king capture
 const int KILLER_MOVES_N = 2;
 const int NULL_MOVE_R = 2;
-const int MAX_HISTORY_TABLE_VAL = 250;
+const int FUTILITY_DEPTH = 3;
+const int FUTILITY_MARGIN = 150; // per ply left
+const int REVERSE_FUTILITY_DEPTH = 6;
+const int REVERSE_FUTILITY_MARGIN = 300; // per ply left
+const int LATE_MOVE_PRUNING_DEPTH = 3;
+const int LMR_MIN_DEPTH = 3;
+const int ASPIRATION_MIN_DEPTH = 4;
+const int ASPIRATION_WINDOW = 25; // initial half width, grows by half on every fail
+const int MAX_THREADS = 256;
+const int MAX_HASH = 1 << 17; // megabytes
+const int MAX_MULTI_PV = 64;
+const size_t THREAD_STACK_SIZE = 32 * 1024 * 1024; // bytes, same as the linker sets on Windows
+const int MAX_HISTORY_TABLE_VAL = 8192; // history entries stay within +-, fits int16
+const int HISTORY_BONUS_SCALE = 32; // bonus = scale * depth^2
+const int MAX_HISTORY_BONUS = 2048;
 const std::string DEFAULT_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
 //disable by setting value to negative number
@@ -20,7 +37,6 @@ enum MetricTypes : int {
     CACHE_HITS,
     PV_HITS,
     PV_MISSES,
-    TT_WRITTEN,
     TT_ENTRIES
 };
 
@@ -28,6 +44,16 @@ struct SearchParams {
     int depthLimit;
     int timeLimit;
     int nodeLimit;
+
+    // game clock in milliseconds, used when there is no fixed time per move
+    long long whiteTime;
+    long long blackTime;
+    long long whiteIncrement;
+    long long blackIncrement;
+    int movesToGo;
+    int mateLimit; // moves, stop once a mate this fast is found
+    bool infinite;
+    bool ponder;
 };
 
 /**
@@ -74,6 +100,14 @@ namespace WinState {
     const int NORMAL = 2;
 }
 
+/**
+ * Mate scores
+ * counted in plies from the root, so faster king captures score higher
+ */
+inline int mateIn(int ply) { return EVAL_MAX - ply; }
+inline int matedIn(int ply) { return EVAL_MIN + ply; }
+inline bool isMateScore(int score) { return score >= MATE_BOUND || score <= -MATE_BOUND; }
+
 
 /**
  * Move Generation
@@ -1,7 +1,20 @@
 #include "Config.h"
 
 namespace Config {
+#ifdef EMBEDDED_NNUE
+    std::string nnuePath = EMBEDDED_NETWORK;
+#else
     std::string nnuePath = "";
+#endif
     int transpositionTableSize = 256;
+    int threads = 1;
+    int multiPv = 1;
+    int moveOverhead = 30;
+    bool ponder = false;
+    bool lateMoveReductions = true;
+    bool futilityPruning = true;
+    bool reverseFutilityPruning = true;
+    bool lateMovePruning = true;
+    bool adaptiveNullMove = true;
     HceType hceType = HceType::FULL;
 }
\ No newline at end of file
@@ -5,9 +5,31 @@ namespace Config {
     // Path to nnue network (if given disables HCE)
     extern std::string nnuePath;
 
+    // Value of nnuePath selecting the network embedded at build time
+    const std::string EMBEDDED_NETWORK = "<embedded>";
+
     // Transposition table size in megabytes
     extern int transpositionTableSize;
 
+    // Number of lazy SMP search threads
+    extern int threads;
+
+    // GUI may let the engine search while the opponent thinks (go ponder)
+    extern bool ponder;
+
+    // Milliseconds of the clock kept back for GUI and network delays
+    extern int moveOverhead;
+
+    // Number of best lines searched and reported (UCI MultiPV)
+    extern int multiPv;
+
+    // Pruning and reductions, switchable for A/B tests
+    extern bool lateMoveReductions;
+    extern bool futilityPruning;
+    extern bool reverseFutilityPruning;
+    extern bool lateMovePruning;
+    extern bool adaptiveNullMove;
+
     // Hand-crafted evaluation function to use
     enum class HceType {
         FULL,
@@ -1,11 +1,14 @@
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <thread>
 #include "Driver.h"
 #include "Board.h"
 #include "Search.h"
 #include "UCI.h"
 #include "Config.h"
+#include "Positions.h"
+#include "Timer.h"
 
 void Driver::start() {
     std::string input;
@@ -30,6 +33,31 @@ void Driver::start() {
         }
         if (tokens[0] == "test") {
             perftTest();
+            searchTest();
+        }
+        if (tokens[0] == "ttstress") {
+            int threads = tokens.size() > 1 ? std::stoi(tokens[1]) : (int) std::thread::hardware_concurrency();
+            double seconds = tokens.size() > 2 ? std::stod(tokens[2]) : 5;
+            ttStressTest(std::max(1, threads), seconds);
+        }
+        if (tokens[0] == "bench") {
+            int depth = tokens.size() > 1 ? std::stoi(tokens[1]) : 8;
+            int threads = tokens.size() > 2 ? std::stoi(tokens[2]) : 1;
+            int hash = tokens.size() > 3 ? std::stoi(tokens[3]) : 16;
+            bench(depth, std::clamp(threads, 1, MAX_THREADS), std::clamp(hash, 1, MAX_HASH), tokens.size() > 4 ? tokens[4] : "");
+        }
+        if (tokens[0] == "nnuecheck") {
+            nnueCheck(tokens[1]);
+        }
+        if (tokens[0] == "batcheval") {
+            int threads = tokens.size() > 4 ? std::stoi(tokens[4]) : (int) std::thread::hardware_concurrency();
+            batchEvaluate(tokens[1], tokens[2], tokens[3], std::max(1, threads));
+        }
+        if (tokens[0] == "nnueconvert") {
+            auto nnue = NNUE::loadNetwork(tokens[1]);
+            if (nnue) {
+                nnue->save(tokens[2]);
+            }
         }
         if (tokens[0] == "q") {
             break;
@@ -42,9 +70,14 @@ void Driver::uciMode() {
     UCI::sendOptions();
     UCI::uciOk();
 
-    Search search;
     Board board = Board::fromFen(DEFAULT_FEN);
-    NNUE::NNUE nnue;
+    std::unique_ptr<NNUE::Network> nnue;
+    if (!Config::nnuePath.empty()) {
+        nnue = loadNetwork();
+    }
+
+    // declared last so that the worker is joined before the network it uses is destroyed
+    Search search;
 
     std::string input;
     while (true) {
@@ -53,52 +86,127 @@ void Driver::uciMode() {
 
         if (tokens.empty()) continue;
 
+        // everything that touches the search, the network or the options runs on the search worker,
+        // in order and between searches, only stop and ponderhit act right away
         if (tokens[0] == "isready") {
-            std::cout << "readyok" << std::endl;
+            search.isReady();
         } else if (tokens[0] == "ucinewgame") {
-            search.resetCache();
+            search.post([&search]() { search.resetCache(); });
         } else if (tokens[0] == "position") {
             board = UCI::parsePosition(tokens);
         } else if (tokens[0] == "go") {
             SearchParams params = UCI::parseGo(tokens);
-            if(!Config::nnuePath.empty()){
-                board.nnue = &nnue;
-                initNnueFromBoard(board, nnue);
-            }
-            search.setBoard(board);
-            search.startSearch(params);
+            search.go(params, [&search, &nnue, board]() mutable {
+                board.nnue = Config::nnuePath.empty() ? nullptr : nnue.get();
+                if(board.nnue){
+                    initNnueFromBoard(board, *nnue);
+                }
+                search.setBoard(board);
+            });
+        } else if (tokens[0] == "ponderhit") {
+            search.ponderhit();
         } else if (tokens[0] == "stop") {
             search.killSearch();
         } else if (tokens[0] == "quit") {
             search.killSearch();
             break;
         } else if (tokens[0] == "setoption") {
-            UCI::setOption(tokens);
-            // TODO: Ugly ifs
-            if (tokens[2] == "NNUEPath" && !Config::nnuePath.empty()){
-                nnue.loadNetwork(Config::nnuePath);
-            }
-            if (tokens[2] == "Hash"){
-                search.tTable.resize();
-            }
+            search.post([&search, &nnue, tokens]() {
+                UCI::setOption(tokens);
+                if (tokens.size() < 3) {
+                    return;
+                }
+                // TODO: Ugly ifs
+                if (tokens[2] == "NNUEPath" && !Config::nnuePath.empty()){
+                    nnue = loadNetwork();
+                }
+                if (tokens[2] == "Hash"){
+                    search.tTable.resize();
+                }
+            });
         } else {
             std::cout << "Unknown Input: " << input << std::endl;
         }
     }
 }
 
-void Driver::initNnueFromBoard(Board &board, NNUE::NNUE &nnue) {
-    nnue.accumulator.setDepth(0);
-    nnue.accumulator.init();
-    for (int color : {WHITE, BLACK}) {
-        for (int piece : PieceTypes) {
-            for (int i = 0; i < board.pieceCounts[color][piece]; i++) {
-                int pos = board.pieces[color][piece][i];
-                nnue.accumulator.stageChange<false>(pos, piece, color);
+void Driver::nnueCheck(const std::string &networkPath) {
+    const int repeats = 20000;
+
+    auto network = NNUE::loadNetwork(networkPath);
+    if (!network) {
+        return;
+    }
+    auto &nnue = *network;
+
+    const NNUE::Kernels::KernelSet *kernelSets[8];
+    int kernelSetCount = NNUE::Kernels::supported(kernelSets);
+
+    std::cout << "===== NNUE " << nnue.architecture() << " int8 sparse vs int16 dense on "
+              << TEST_POSITIONS.size() << " positions =====" << std::endl;
+
+    // evaluations of the scalar kernels, every instruction set has to reproduce them exactly
+    std::vector<int> reference;
+
+    for (int k = 0; k < kernelSetCount; k++) {
+        nnue.setKernels(*kernelSets[k]);
+
+        int maxError = 0;
+        long long totalError = 0;
+        int mismatches = 0;
+        int evaluations = 0;
+        double sparseSeconds = 0;
+        double denseSeconds = 0;
+        volatile int sink = 0;
+
+        for (const auto &fen : TEST_POSITIONS) {
+            Board board = Board::fromFen(fen);
+            board.nnue = &nnue;
+            initNnueFromBoard(board, nnue);
+
+            for (int side : {WHITE, BLACK}) {
+                int eval = nnue.evaluateSparse(side);
+                int error = std::abs(eval - nnue.evaluateDense(side));
+                maxError = std::max(maxError, error);
+                totalError += error;
+
+                if (k == 0) {
+                    reference.push_back(eval);
+                }
+                mismatches += eval != reference[evaluations];
+                evaluations++;
+
+                Timer timer;
+                timer.measure([&] { for (int i = 0; i < repeats; i++) sink = sink + nnue.evaluateSparse(side); });
+                sparseSeconds += timer.getSeconds();
+                timer.measure([&] { for (int i = 0; i < repeats; i++) sink = sink + nnue.evaluateDense(side); });
+                denseSeconds += timer.getSeconds();
             }
         }
+
+        double sparseNs = sparseSeconds * 1e9 / (evaluations * repeats);
+        double denseNs = denseSeconds * 1e9 / (evaluations * repeats);
+
+        std::cout << std::fixed << std::setprecision(1) << kernelSets[k]->name << ": ";
+        std::cout << "max error: " << maxError << " cp, mean error: " << (double) totalError / evaluations << " cp, ";
+        std::cout << "mismatches vs scalar: " << mismatches << ", ";
+        std::cout << "dense: " << denseNs << " ns/eval, sparse: " << sparseNs << " ns/eval, ";
+        std::cout << "speedup: " << std::setprecision(2) << denseNs / sparseNs << "x" << std::endl;
+    }
+
+    nnue.setKernels(NNUE::Kernels::active());
+}
+
+std::unique_ptr<NNUE::Network> Driver::loadNetwork() {
+    auto nnue = Config::nnuePath == Config::EMBEDDED_NETWORK
+                ? NNUE::loadEmbeddedNetwork()
+                : NNUE::loadNetwork(Config::nnuePath);
+
+    // fall back to HCE
+    if (!nnue) {
+        Config::nnuePath = "";
     }
-    nnue.accumulator.applyStagedChanges(false);
+    return nnue;
 }
 
 std::vector<std::string> Driver::tokenizeString(const std::string &s, char delimiter) {
@@ -15,5 +15,14 @@ class Driver {
     std::vector<std::string> tokenizeString(const std::string &s, char delimiter);
     void uciMode();
     void perftTest();
-    static void initNnueFromBoard(Board &board, NNUE::NNUE &nnue);
+    void searchTest();
+    void ttStressTest(int threads, double seconds);
+    void bench(int depth, int threads, int hashMegabytes, const std::string &networkPath);
+    void nnueCheck(const std::string &networkPath);
+    void batchEvaluate(const std::string &networkPath,
+                       const std::string &inputPath,
+                       const std::string &outputPath,
+                       int threads);
+    static NNUE::NetworkInput networkInputFromBoard(const Board &board);
+    static std::unique_ptr<NNUE::Network> loadNetwork();
 };
\ No newline at end of file
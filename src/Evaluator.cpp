@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "Evaluator.h"
 #include "Common.h"
 #include "EvalParms.h"
@@ -20,11 +21,10 @@ int Evaluator::evaluateRelative(Board &board) {
         return 0;
     }
 
-    if (board.nnue) {
-        return board.nnue->evaluate(board.moveColor);
-    } else {
-        return evaluate(board) * (board.moveColor == WHITE ? 1 : -1);
-    }
+    // kept out of the mate score range
+    int eval = board.nnue ? board.nnue->evaluate(board.moveColor)
+                          : evaluate(board) * (board.moveColor == WHITE ? 1 : -1);
+    return std::clamp(eval, -MATE_BOUND + 1, MATE_BOUND - 1);
 }
 
 int Evaluator::evaluate(Board &board) {
@@ -59,8 +59,9 @@ int Evaluator::getWinState(Board &board) {
     board.nnue = nullptr;
 
     bool hasLegalMoves = false;
+    Board::UndoInfo undo;
     for (int i = 0; i < generator.size() && !hasLegalMoves; i++) {
-        board.makeMove(generator[i]);
+        board.makeMove(generator[i], undo);
         hasLegalMoves |= board.isLegal();
         board.unmakeMove();
     }
@@ -78,7 +79,8 @@ int Evaluator::getWinState(Board &board) {
 int Evaluator::mobilityBonus(Board &board) {
     int currentPlayerMoves = generator.size();
 
-    board.makeMove(Move(0, 0, MoveFlags::NULL_MOVE));
+    Board::UndoInfo undo;
+    board.makeMove(Move(0, 0, MoveFlags::NULL_MOVE), undo);
     generator.setCountOnly(true);
     generator.generateMoves(board);
     generator.setCountOnly(false);
@@ -176,6 +178,7 @@ int Evaluator::evalPieces(Board &board, int phase) {
 int Evaluator::kingSafety(Board &board) {
     int attackedSquares[2] = {};
     int touchingSquares[2] = {};
+    Board::UndoInfo undo;
 
     for (int i = 0; i <= 1; i++) {
         int color = board.moveColor;
@@ -194,7 +197,7 @@ int Evaluator::kingSafety(Board &board) {
         }
 
         if (i == 0) {
-            board.makeMove(Move(0, 0, MoveFlags::NULL_MOVE));
+            board.makeMove(Move(0, 0, MoveFlags::NULL_MOVE), undo);
         } else {
             board.unmakeMove();
         }
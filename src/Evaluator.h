@@ -10,7 +10,7 @@ class Evaluator {
 
  private:
     std::array<int, 10> pieceWeights{};
-    MoveGenerator generator{true};
+    MoveGenerator generator{1, true}; // one frame, castling and capture scores are not needed
 
     int getWinState(Board &board);
     static int materialAdvantage(Board &board);
@@ -1,32 +1,110 @@
 #pragma once
 
-#include <unordered_map>
-#include <string>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Common.h"
+
+namespace Metrics {
+    constexpr int SLOTS = 16;
+
+    // counters of one thread, whole cache lines so that threads never write to the same line
+    struct alignas(64) Block {
+        std::array<std::atomic<int64_t>, SLOTS> values{};
+        bool inUse = false;
+    };
+
+    // totals over all threads
+    using Snapshot = std::array<int64_t, SLOTS>;
+
+    inline std::mutex registryMutex;
+    inline std::vector<std::unique_ptr<Block>> registry;
+
+    // blocks of finished threads are handed to new ones, their counts stay in the totals
+    inline Block &acquire() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto &block : registry) {
+            if (!block->inUse) {
+                block->inUse = true;
+                return *block;
+            }
+        }
+        registry.push_back(std::make_unique<Block>());
+        registry.back()->inUse = true;
+        return *registry.back();
+    }
+
+    struct LocalBlock {
+        Block *block = nullptr;
+        ~LocalBlock() {
+            if (block) {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                block->inUse = false;
+            }
+        }
+    };
+    inline thread_local LocalBlock localBlock;
+
+    inline Block &local() {
+        if (!localBlock.block) {
+            localBlock.block = &acquire();
+        }
+        return *localBlock.block;
+    }
+
+    inline Snapshot snapshot() {
+        Snapshot totals{};
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto &block : registry) {
+            for (int i = 0; i < SLOTS; i++) {
+                totals[i] += block->values[i].load(std::memory_order_relaxed);
+            }
+        }
+        return totals;
+    }
+
+    inline Snapshot difference(const Snapshot &a, const Snapshot &b) {
+        Snapshot delta{};
+        for (int i = 0; i < SLOTS; i++) {
+            delta[i] = a[i] - b[i];
+        }
+        return delta;
+    }
+}
 
 template<int ID, typename T = int64_t>
 class Metric {
  public:
+    static_assert(ID < Metrics::SLOTS);
+    static constexpr bool ENABLED = USE_METRICS && ID >= 0;
+
+    // only the owning thread writes its block, a plain load and store is enough
     static void inc(T n = 1) {
-        if (USE_METRICS && ID >= 0) {
-            value += n;
+        if constexpr (ENABLED) {
+            auto &value = Metrics::local().values[ID];
+            value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
         }
     }
     static void dec(T n = 1) {
-        if (USE_METRICS && ID >= 0) {
-            value -= n;
-        }
+        inc(-n);
     }
+    // for gauges, the value replaces the counts of all threads
     static void set(T n = 1) {
-        if (USE_METRICS && ID >= 0) {
-            value = n;
+        if constexpr (ENABLED) {
+            auto &own = Metrics::local();
+            std::lock_guard<std::mutex> lock(Metrics::registryMutex);
+            for (auto &block : Metrics::registry) {
+                block->values[ID].store(block.get() == &own ? n : 0, std::memory_order_relaxed);
+            }
         }
     }
     static T get() {
-        return value;
+        if constexpr (ENABLED) {
+            return static_cast<T>(Metrics::snapshot()[ID]);
+        }
+        return 0;
     }
- private:
-    static T value;
 };
-
-template<int ID, typename T>
-T Metric<ID, T>::value = 0;
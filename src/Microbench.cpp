@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include "Board.h"
+#include "Config.h"
+#include "Evaluator.h"
+#include "MoveGenerator.h"
+#include "NnueKernels.h"
+#include "Positions.h"
+#include "Timer.h"
+#include "TranspositionTable.h"
+
+/**
+ * MICROBENCHMARKS
+ * Times the hot primitives of the engine in isolation, one line per benchmark:
+ *     name ns/op ops/s
+ * The output can be saved and passed back with --baseline to print the change against it.
+ *
+ * usage: BoomChessMicrobench [--network file] [--baseline file] [--filter prefix] [--time seconds]
+ */
+
+// results are summed into it, so the compiler can't drop the benchmarked calls
+static volatile long long sink;
+
+/**
+ * CORPUS
+ * The test positions and every position one legal move away from them,
+ * so there are openings, middlegames, checks and positions right after explosions
+ */
+struct Corpus {
+    // a piece appearing on or leaving a square, replayed into the network as staged changes
+    struct FeatureChange {
+        int square;
+        int piece;
+        int color;
+        bool removed;
+    };
+
+    std::vector<std::string> fens;
+    std::vector<Board> boards;
+
+    // pseudo legal moves of every board
+    std::vector<std::vector<Move>> quietMoves;
+    std::vector<std::vector<Move>> captureMoves;
+
+    // network changes of every quiet move and capture of every board
+    std::vector<std::vector<FeatureChange>> quietChanges;
+    std::vector<std::vector<FeatureChange>> captureChanges;
+};
+
+static std::vector<Corpus::FeatureChange> changesOf(Board &board, const Move &move) {
+    BoardArray before = board.board;
+    Board::UndoInfo undo;
+    board.makeMove(move, undo);
+
+    std::vector<Corpus::FeatureChange> changes;
+    for (int square = 0; square < 128; square++) {
+        if (!Board::inBounds(square) || before[square].piece == board.board[square].piece) {
+            continue;
+        }
+        if (before[square].type() != EMPTY) {
+            changes.push_back({square, before[square].type(), before[square].color(), true});
+        }
+        if (board[square].type() != EMPTY) {
+            changes.push_back({square, board[square].type(), board[square].color(), false});
+        }
+    }
+
+    board.unmakeMove();
+    return changes;
+}
+
+static Corpus buildCorpus() {
+    Corpus corpus;
+    MoveGenerator generator;
+    Board::UndoInfo undo;
+
+    for (const auto &fen : TEST_POSITIONS) {
+        Board board = Board::fromFen(fen);
+        corpus.fens.push_back(fen);
+
+        generator.generateMoves(board);
+        for (int i = 0; i < generator.size(); i++) {
+            if (!board.tryMakeMove(generator[i], undo)) {
+                continue;
+            }
+            // games are over once a king explodes, the engine never looks further
+            if (!board.isKingCaptured()) {
+                corpus.fens.push_back(board.toFen());
+            }
+            board.unmakeMove();
+        }
+    }
+
+    for (const auto &fen : corpus.fens) {
+        Board board = Board::fromFen(fen);
+        std::vector<Move> quiets, captures;
+        std::vector<Corpus::FeatureChange> quietChanges, captureChanges;
+
+        generator.generateMoves(board);
+        for (int i = 0; i < generator.size(); i++) {
+            const Move &move = generator[i];
+            if (move.flags & (MoveFlags::CASTLE_SUBMASK | MoveFlags::PROMOTION_SUBMASK)) {
+                continue;
+            }
+
+            bool capture = move.flags & MoveFlags::CAPTURE;
+            (capture ? captures : quiets).push_back(move);
+
+            auto changes = changesOf(board, move);
+            auto &target = capture ? captureChanges : quietChanges;
+            target.insert(target.end(), changes.begin(), changes.end());
+            // an empty change marks the end of a move
+            target.push_back({-1, EMPTY, WHITE, false});
+        }
+
+        corpus.boards.push_back(board);
+        corpus.quietMoves.push_back(std::move(quiets));
+        corpus.captureMoves.push_back(std::move(captures));
+        corpus.quietChanges.push_back(std::move(quietChanges));
+        corpus.captureChanges.push_back(std::move(captureChanges));
+    }
+
+    return corpus;
+}
+
+/**
+ * BENCHMARKS
+ * A pass runs over the whole corpus and returns the operations it did and the time they took,
+ * setup that is not part of the measured operation stays outside of that time
+ */
+struct Pass {
+    long long ops;
+    double seconds;
+};
+
+struct Benchmark {
+    std::string name;
+    std::function<Pass()> run;
+};
+
+template<class F>
+static Pass timed(F &&f) {
+    Timer timer;
+    timer.start();
+    long long ops = f();
+    timer.end();
+    return {ops, timer.getSeconds()};
+}
+
+static std::vector<Benchmark> makeBenchmarks(Corpus &corpus, NNUE::Network *network, TranspositionTable &table,
+                                             const std::vector<uint64_t> &storedKeys,
+                                             const std::vector<uint64_t> &missingKeys) {
+    std::vector<Benchmark> benchmarks;
+    auto generator = std::make_shared<MoveGenerator>();
+    auto evaluator = std::make_shared<Evaluator>();
+
+    auto makeUnmake = [&corpus](std::vector<std::vector<Move>> &moves) {
+        return [&corpus, &moves] {
+            return timed([&] {
+                Board::UndoInfo undo;
+                long long ops = 0;
+                for (size_t b = 0; b < corpus.boards.size(); b++) {
+                    Board &board = corpus.boards[b];
+                    for (const Move &move : moves[b]) {
+                        board.makeMove(move, undo);
+                        board.unmakeMove();
+                    }
+                    ops += (long long) moves[b].size();
+                    sink += board.zobristKey.value;
+                }
+                return ops;
+            });
+        };
+    };
+    benchmarks.push_back({"make_unmake_quiet", makeUnmake(corpus.quietMoves)});
+    benchmarks.push_back({"make_unmake_capture", makeUnmake(corpus.captureMoves)});
+
+    benchmarks.push_back({"generate_moves", [&corpus, generator] {
+        return timed([&] {
+            for (Board &board : corpus.boards) {
+                generator->generateMoves(board);
+                sink += generator->size();
+            }
+            return (long long) corpus.boards.size();
+        });
+    }});
+
+    // the full ordering, as in a node where no move cuts off
+    benchmarks.push_back({"generate_and_sort", [&corpus, generator] {
+        return timed([&] {
+            for (Board &board : corpus.boards) {
+                generator->generateMoves(board);
+                for (int i = 0; i < generator->size(); i++) {
+                    sink += generator->getSorted(i, board).to;
+                }
+            }
+            return (long long) corpus.boards.size();
+        });
+    }});
+
+    benchmarks.push_back({"is_attacked", [&corpus] {
+        return timed([&] {
+            long long ops = 0, attacked = 0;
+            for (Board &board : corpus.boards) {
+                for (int square = 0; square < 128; square++) {
+                    if (Board::inBounds(square)) {
+                        attacked += board.isAttacked(square);
+                        ops++;
+                    }
+                }
+            }
+            sink += attacked;
+            return ops;
+        });
+    }});
+
+    // all but the 40 root positions are the position after a move, as the search checks it
+    benchmarks.push_back({"is_legal", [&corpus] {
+        return timed([&] {
+            long long legal = 0;
+            for (Board &board : corpus.boards) {
+                legal += board.isLegal();
+            }
+            sink += legal;
+            return (long long) corpus.boards.size();
+        });
+    }});
+
+    auto evaluateHce = [&corpus, evaluator](Config::HceType type) {
+        return [&corpus, evaluator, type] {
+            auto savedType = Config::hceType;
+            Config::hceType = type;
+            auto pass = timed([&] {
+                for (Board &board : corpus.boards) {
+                    sink += evaluator->evaluateRelative(board);
+                }
+                return (long long) corpus.boards.size();
+            });
+            Config::hceType = savedType;
+            return pass;
+        };
+    };
+    benchmarks.push_back({"eval_hce_full", evaluateHce(Config::HceType::FULL)});
+    benchmarks.push_back({"eval_hce_simple", evaluateHce(Config::HceType::SIMPLE)});
+
+    if (network) {
+        // the work of an update doesn't depend on the accumulator values, so all of them start from one
+        auto updateNnue = [&corpus, network](std::vector<std::vector<Corpus::FeatureChange>> &changes) {
+            return [&corpus, network, &changes] {
+                initNnueFromBoard(corpus.boards[0], *network);
+                return timed([&] {
+                    long long ops = 0;
+                    network->increaseDepth();
+                    for (const auto &boardChanges : changes) {
+                        for (const auto &change : boardChanges) {
+                            if (change.square < 0) {
+                                network->applyStagedChanges();
+                                ops++;
+                            } else if (change.removed) {
+                                network->stageChange<true>(change.square, change.piece, change.color);
+                            } else {
+                                network->stageChange<false>(change.square, change.piece, change.color);
+                            }
+                        }
+                    }
+                    network->decreaseDepth();
+                    return ops;
+                });
+            };
+        };
+        benchmarks.push_back({"nnue_update_quiet", updateNnue(corpus.quietChanges)});
+        benchmarks.push_back({"nnue_update_capture", updateNnue(corpus.captureChanges)});
+
+        // sparse kernels skip zero activations, so every board gets its own accumulator
+        benchmarks.push_back({"nnue_evaluate", [&corpus, network] {
+            const int repeats = 16;
+            Pass pass{0, 0};
+            for (const Board &board : corpus.boards) {
+                initNnueFromBoard(board, *network);
+                Pass boardPass = timed([&] {
+                    for (int i = 0; i < repeats; i++) {
+                        sink += network->evaluate(board.moveColor);
+                    }
+                    return (long long) repeats;
+                });
+                pass.ops += boardPass.ops;
+                pass.seconds += boardPass.seconds;
+            }
+            return pass;
+        }});
+    }
+
+    benchmarks.push_back({"fen_parse", [&corpus] {
+        return timed([&] {
+            for (const auto &fen : corpus.fens) {
+                sink += Board::fromFen(fen).zobristKey.value;
+            }
+            return (long long) corpus.fens.size();
+        });
+    }});
+
+    auto probe = [&table](const std::vector<uint64_t> &keys) {
+        return [&table, &keys] {
+            return timed([&] {
+                SearchEntry entry;
+                long long hits = 0;
+                for (uint64_t key : keys) {
+                    hits += table.probe(key, entry);
+                }
+                sink += hits;
+                return (long long) keys.size();
+            });
+        };
+    };
+    benchmarks.push_back({"tt_probe_hit", probe(storedKeys)});
+    benchmarks.push_back({"tt_probe_miss", probe(missingKeys)});
+
+    return benchmarks;
+}
+
+/**
+ * BASELINE
+ * a previous output of this program, name to ns/op
+ */
+static std::map<std::string, double> readBaseline(const std::string &path) {
+    std::map<std::string, double> baseline;
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not open baseline " << path << std::endl;
+        exit(1);
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream lineStream(line);
+        std::string name;
+        double nanosPerOp;
+        if (line.empty() || line[0] == '#' || !(lineStream >> name >> nanosPerOp)) {
+            continue;
+        }
+        baseline[name] = nanosPerOp;
+    }
+    return baseline;
+}
+
+int main(int argc, char **argv) {
+    std::string networkPath, baselinePath, filter;
+    double secondsPerBenchmark = 1.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "--network") {
+            networkPath = argv[++i];
+        } else if (i + 1 < argc && arg == "--baseline") {
+            baselinePath = argv[++i];
+        } else if (i + 1 < argc && arg == "--filter") {
+            filter = argv[++i];
+        } else if (i + 1 < argc && arg == "--time") {
+            secondsPerBenchmark = std::max(0.01, std::stod(argv[++i]));
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--network file] [--baseline file] [--filter prefix] [--time seconds]" << std::endl;
+            return 1;
+        }
+    }
+
+    auto baseline = baselinePath.empty() ? std::map<std::string, double>{} : readBaseline(baselinePath);
+
+    // the given network, otherwise the embedded one, otherwise only the HCE benchmarks run
+    std::unique_ptr<NNUE::Network> network;
+    if (!networkPath.empty()) {
+        network = NNUE::loadNetwork(networkPath);
+        if (!network) {
+            return 1;
+        }
+    } else if (NNUE::hasEmbeddedNetwork()) {
+        network = NNUE::loadEmbeddedNetwork();
+    }
+
+    Corpus corpus = buildCorpus();
+
+    // a table big enough to miss the caches, filled to about a quarter
+    const int tableMegabytes = 64;
+    const int keyCount = 1 << 20;
+    TranspositionTable table(tableMegabytes);
+    table.wait();
+
+    std::vector<uint64_t> storedKeys(keyCount), missingKeys(keyCount);
+    std::mt19937_64 keyGenerator(42);
+    for (int i = 0; i < keyCount; i++) {
+        storedKeys[i] = keyGenerator();
+        missingKeys[i] = keyGenerator();
+
+        SearchEntry entry;
+        entry.value = (int) (storedKeys[i] % 1000) - 500;
+        entry.depth = (int) (storedKeys[i] >> 32) % 20;
+        entry.bound = EXACT;
+        entry.bestMove = Move((int) (storedKeys[i] >> 40) & 0x77, (int) (storedKeys[i] >> 48) & 0x77);
+        table.store(storedKeys[i], entry);
+    }
+
+    std::cout << "# corpus " << corpus.boards.size() << " positions, kernels "
+              << NNUE::Kernels::active().name;
+    if (network) {
+        std::cout << ", network " << network->architecture();
+    }
+    std::cout << std::endl;
+    if (!network) {
+        std::cout << "# nnue benchmarks skipped, no network" << std::endl;
+    }
+    std::cout << "# benchmark ns/op ops/s" << (baseline.empty() ? "" : " baseline_ns/op change%") << std::endl;
+
+    auto benchmarks = makeBenchmarks(corpus, network.get(), table, storedKeys, missingKeys);
+    for (auto &benchmark : benchmarks) {
+        // a whole name or the start of names, "tt" runs tt_probe_hit and tt_probe_miss
+        if (benchmark.name.compare(0, filter.size(), filter) != 0) {
+            continue;
+        }
+
+        // the fastest of several rounds, the others are disturbed by something else on the machine
+        const int rounds = 5;
+        benchmark.run(); // warm up
+        double bestNanosPerOp = 1e18;
+        for (int round = 0; round < rounds; round++) {
+            Pass total{0, 0};
+            while (total.seconds < secondsPerBenchmark / rounds) {
+                Pass pass = benchmark.run();
+                total.ops += pass.ops;
+                total.seconds += pass.seconds;
+            }
+            bestNanosPerOp = std::min(bestNanosPerOp, total.seconds * 1e9 / (double) total.ops);
+        }
+
+        std::cout << std::left << std::setw(22) << benchmark.name << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(12) << bestNanosPerOp
+                  << std::setprecision(0) << std::setw(14) << 1e9 / bestNanosPerOp;
+
+        auto previous = baseline.find(benchmark.name);
+        if (previous != baseline.end()) {
+            std::cout << std::setprecision(2) << std::setw(12) << previous->second
+                      << std::showpos << std::setw(10) << (bestNanosPerOp / previous->second - 1) * 100
+                      << std::noshowpos;
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
@@ -1,10 +1,11 @@
+#include <cstdlib>
 #include "MoveGenerator.h"
 #include "Common.h"
 #include "EvalParms.h"
 
 void MoveGenerator::generateMoves(const Board &board) {
-    n[curDepth] = 0;
-    nSorted[curDepth] = 0;
+    frame->size = 0;
+    frame->sorted = 0;
 
     //no legal moves if king ded
     if (board.pieceCounts[board.moveColor][KING] == 0) {
@@ -189,29 +190,33 @@ void MoveGenerator::generateSlidingMoves(const Board &board, int startingSquare,
 }
 
 void MoveGenerator::sortTill(int idx, const Board &board) {
-    if (idx < nSorted[curDepth]) {
+    if (idx < frame->sorted) {
         return;
     }
 
-    for (int i = nSorted[curDepth]; i <= idx; i++) {
+    for (int i = frame->sorted; i <= idx; i++) {
         // ordering:
         // 1. winning/equal captures
         // 2. killers
-        // 3. history
+        // 3. counter move
+        // 4. history + continuation history
 
+        // moves without a positive score keep the generation order
         int64_t bestMoveScore = 0;
         int bestMove = i;
 
-        for (int j = i; j < n[curDepth]; j++) {
+        for (int j = i; j < frame->size; j++) {
             auto move = (*this)[j];
             int64_t curMoveScore = 0;
 
-            const int killerOffset = (MAX_HISTORY_TABLE_VAL + 1);
-            const int mvvOffset = killerOffset * (KILLER_MOVES_N + 1);
+            const int64_t historyRange = 3 * (MAX_HISTORY_TABLE_VAL + 1); // history and two continuation plies
+            const int64_t counterOffset = historyRange;
+            const int64_t killerOffset = 2 * historyRange;
+            const int64_t mvvOffset = killerOffset * (KILLER_MOVES_N + 1);
 
             //assign MVV-LVA score, we want score to be > 0 for equal captures and < 0 for loosing captures
             if (move.flags & MoveFlags::CAPTURE) {
-                int score = captureScore[curDepth][j];
+                int score = frame->captureScores[j];
                 if (score >= 0) score++;
                 curMoveScore += mvvOffset * score;
             }
@@ -231,7 +236,7 @@ void MoveGenerator::sortTill(int idx, const Board &board) {
             //assign killer heuristic score
             if (!(move.flags & MoveFlags::CAPTURE)) {
                 int killerId = KILLER_MOVES_N;
-                for (const Move &killer : killers[curDepth]) {
+                for (const Move &killer : frame->killers) {
                     if (killer.same(move)) {
                         curMoveScore += killerOffset * killerId;
                         break;
@@ -240,6 +245,14 @@ void MoveGenerator::sortTill(int idx, const Board &board) {
                 }
             }
 
+            //assign counter move and continuation history score
+            if (quietHistory && !(move.flags & MoveFlags::CAPTURE)) {
+                if (quietHistory->isCounter(curDepth, move)) {
+                    curMoveScore += counterOffset;
+                }
+                curMoveScore += quietHistory->score(curDepth, board, move);
+            }
+
             //assign history score
             curMoveScore += historyTable[board.moveColor][move.from][move.to];
 
@@ -250,17 +263,17 @@ void MoveGenerator::sortTill(int idx, const Board &board) {
 
         }
 
-        std::swap(moves[curDepth][i], moves[curDepth][bestMove]);
-        std::swap(captureScore[curDepth][i], captureScore[curDepth][bestMove]);
+        std::swap(frame->moves[i], frame->moves[bestMove]);
+        std::swap(frame->captureScores[i], frame->captureScores[bestMove]);
     }
 
-    nSorted[curDepth] = idx + 1;
+    frame->sorted = idx + 1;
 }
 
 void MoveGenerator::calculateLatestCaptureScore(const Board &board) {
     if (fast) return;
 
-    auto move = moves[curDepth][size() - 1];
+    auto move = frame->moves[size() - 1];
     int score = -EvalParams::PieceWeights[board[move.from].type()];
     for (int direction : explosionDirections) {
         int captureIdx = move.to + direction;
@@ -269,51 +282,51 @@ void MoveGenerator::calculateLatestCaptureScore(const Board &board) {
             score += EvalParams::PieceWeights[board[captureIdx].type()] * (friendly ? -1 : 1);
         }
     }
-    captureScore[curDepth][size() - 1] = score;
+    frame->captureScores[size() - 1] = score;
 }
 
-void MoveGenerator::sortTT(const Move &move) {
+bool MoveGenerator::sortTT(const Move &move, bool goodCapturesOnly) {
     if(move.flags & MoveFlags::NULL_MOVE){
-        return;
+        return false;
     }
 
-    for (int i = 0; i < n[curDepth]; i++) {
-        if (moves[curDepth][i].from == move.from && moves[curDepth][i].to == move.to) {
-            std::swap(moves[curDepth][0], moves[curDepth][i]);
-            std::swap(captureScore[curDepth][0], captureScore[curDepth][i]);
-            nSorted[curDepth] = 1;
-            break;
+    // the TT only keeps squares and promotion, the generated move carries the rest of the flags
+    const int promotion = move.flags & MoveFlags::PROMOTION_SUBMASK;
+    for (int i = 0; i < frame->size; i++) {
+        if (frame->moves[i].from == move.from && frame->moves[i].to == move.to
+            && (frame->moves[i].flags & MoveFlags::PROMOTION_SUBMASK) == promotion) {
+            // quiescence search stops at the first move that is not a good capture
+            if (goodCapturesOnly && !isGoodCapture(i)) {
+                return false;
+            }
+            std::swap(frame->moves[0], frame->moves[i]);
+            std::swap(frame->captureScores[0], frame->captureScores[i]);
+            frame->sorted = 1;
+            return true;
         }
     }
+    return false;
 }
 
 void MoveGenerator::markKiller(int idx) {
-    auto move = moves[curDepth][idx];
-    if (!(move.flags & MoveFlags::CAPTURE) && !killers[curDepth][0].same(move)) {
+    auto move = frame->moves[idx];
+    if (!(move.flags & MoveFlags::CAPTURE) && !frame->killers[0].same(move)) {
         for (int i = KILLER_MOVES_N - 1; i > 0; i--) {
-            killers[curDepth][i] = killers[curDepth][i - 1];
+            frame->killers[i] = frame->killers[i - 1];
         }
-        killers[curDepth][0] = move;
+        frame->killers[0] = move;
     }
 }
 
 bool MoveGenerator::isGoodCapture(int idx) {
-    auto move = moves[curDepth][idx];
-    return move.flags & MoveFlags::CAPTURE && captureScore[curDepth][idx] >= 0;
+    auto move = frame->moves[idx];
+    return move.flags & MoveFlags::CAPTURE && frame->captureScores[idx] >= 0;
 }
 
-void MoveGenerator::updateHistory(int sideToMove, const Move &move, int depth) {
-    historyTable[sideToMove][move.from][move.to] += depth * depth;
-    if (historyTable[sideToMove][move.from][move.to] > MAX_HISTORY_TABLE_VAL)
-        ageHistory(sideToMove);
-}
-
-void MoveGenerator::ageHistory(int side) {
-    for (auto &j : historyTable[side]) {
-        for (auto &k : j) {
-            k >>= 1;
-        }
-    }
+void MoveGenerator::updateHistory(int sideToMove, const Move &move, int bonus) {
+    // gravity, the closer the entry is to the bound the less it moves, so it never leaves +-MAX_HISTORY_TABLE_VAL
+    auto &entry = historyTable[sideToMove][move.from][move.to];
+    entry += bonus - entry * std::abs(bonus) / MAX_HISTORY_TABLE_VAL;
 }
 void MoveGenerator::clearHistory() {
     for (auto &i : historyTable) {
@@ -325,17 +338,18 @@ void MoveGenerator::clearHistory() {
     }
 }
 void MoveGenerator::clearKillers() {
-    for(auto &i : killers){
-        for(auto &j : i){
-            j = Move(); //null
-        }
+    for (int ply = 0; ply < stack->size(); ply++) {
+        (*stack)[ply].killers.fill(Move()); //null
     }
 }
 void MoveGenerator::addMove(int from, int to, int flags) {
     if(!countOnly){
-        moves[curDepth][n[curDepth]++] = Move(from, to, flags);
+        // moves past the frame's capacity are dropped, no real game gets there
+        if (frame->size < MAX_MOVES) {
+            frame->moves[frame->size++] = Move(from, to, flags);
+        }
     } else {
-        n[curDepth]++;
+        frame->size++;
     }
 }
 
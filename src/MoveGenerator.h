@@ -2,53 +2,64 @@
 
 #include <array>
 #include <list>
+#include <memory>
 #include "Move.h"
 #include "Board.h"
+#include "QuietHistory.h"
+#include "SearchStack.h"
 
+/**
+ * Moves are generated into the frame of the current depth, the frames come from the search thread's stack
+ * or from a small stack of the generator's own
+ */
 class MoveGenerator {
 
  public:
-    std::array<std::array<Move, 300>, MAX_DEPTH> moves{};
-    std::array<std::array<int, 300>, MAX_DEPTH> captureScore{}; //mvvlva
-    std::array<int, MAX_DEPTH> n{};
-    std::array<int, MAX_DEPTH> nSorted{};
-
-    explicit MoveGenerator(bool fast) : fast(fast) {}
-    MoveGenerator() : fast(false) {}
+    explicit MoveGenerator(SearchStack &stack) : stack(&stack), frame(&stack[0]) {}
+    explicit MoveGenerator(int plies = 1, bool fast = false)
+        : ownStack(std::make_unique<SearchStack>(plies)), stack(ownStack.get()), frame(&(*ownStack)[0]), fast(fast) {}
 
     void generateMoves(const Board &board);
 
     int size() {
-        return n[curDepth];
+        return frame->size;
     }
-    void sortTT(const Move &move);
+    bool sortTT(const Move &move, bool goodCapturesOnly = false);
 
     void increaseDepth() {
-        curDepth++;
+        frame = &(*stack)[++curDepth];
     }
     void decreaseDepth() {
-        curDepth--;
+        frame = &(*stack)[--curDepth];
     }
     void setDepth(int depth) {
         curDepth = depth;
+        frame = &(*stack)[curDepth];
     }
     Move &getSorted(int idx, const Board &board) {
         sortTill(idx, board);
         return (*this)[idx];
     }
     Move &operator[](int idx) {
-        return moves[curDepth][idx];
+        return frame->moves[idx];
     }
     void setCountOnly(bool flag){
         countOnly = flag;
     }
     void markKiller(int idx);
-    void updateHistory(int sideToMove, const Move &move, int depth);
+    void updateHistory(int sideToMove, const Move &move, int bonus);
     void clearHistory();
-    void ageHistory(int side);
     bool isGoodCapture(int idx);
     void clearKillers();
+
+    // counter moves and continuation history of the search thread, none outside the search
+    void setQuietHistory(const QuietHistory *history) {
+        quietHistory = history;
+    }
  private:
+    std::unique_ptr<SearchStack> ownStack;
+    SearchStack *stack;
+    PlyFrame *frame;
     bool fast = false;
     int curDepth = 0;
     int countOnly = false;
@@ -64,6 +75,6 @@ class MoveGenerator {
     void calculateLatestCaptureScore(const Board &board);
     void addMove(int from, int to, int flags = 0);
 
-    std::array<std::array<Move, 2>, MAX_DEPTH> killers{};
     std::array<std::array<std::array<int, 128>, 128>, 2> historyTable{};
+    const QuietHistory *quietHistory = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include <iostream>
+#include "NativeThread.h"
+
+#ifdef _WIN32
+
+// the stack of every thread is set by the linker (see CMakeLists.txt)
+NativeThread::NativeThread(size_t, std::function<void()> function) : function(std::move(function)) {
+    thread = std::thread(this->function);
+    joinable = true;
+}
+
+void NativeThread::join() {
+    if (joinable) {
+        thread.join();
+        joinable = false;
+    }
+}
+
+#else
+
+NativeThread::NativeThread(size_t stackSize, std::function<void()> function) : function(std::move(function)) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, stackSize);
+
+    if (pthread_create(&thread, &attributes, run, this) != 0) {
+        // fall back to the default stack rather than not searching at all
+        if (pthread_create(&thread, nullptr, run, this) != 0) {
+            std::cout << "Failed to start a thread" << std::endl;
+            exit(1);
+        }
+    }
+    joinable = true;
+
+    pthread_attr_destroy(&attributes);
+}
+
+void *NativeThread::run(void *self) {
+    static_cast<NativeThread *>(self)->function();
+    return nullptr;
+}
+
+void NativeThread::join() {
+    if (joinable) {
+        pthread_join(thread, nullptr);
+        joinable = false;
+    }
+}
+
+#endif
+
+NativeThread::~NativeThread() {
+    join();
+}
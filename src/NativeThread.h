@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#ifdef _WIN32
+#include <thread>
+#else
+#include <pthread.h>
+#endif
+
+/**
+ * Joinable thread with an explicitly sized stack, std::thread gets whatever the platform defaults to
+ * (8 MB on Linux, 1 MB on Windows unless the linker raises it, 512 KB on macOS)
+ */
+class NativeThread {
+ public:
+    NativeThread(size_t stackSize, std::function<void()> function);
+    ~NativeThread();
+
+    NativeThread(const NativeThread &) = delete;
+    NativeThread &operator=(const NativeThread &) = delete;
+
+    void join();
+
+ private:
+    std::function<void()> function;
+    bool joinable = false;
+
+#ifdef _WIN32
+    std::thread thread;
+#else
+    pthread_t thread{};
+    static void *run(void *self);
+#endif
+};
@@ -0,0 +1,31 @@
+#include "NnueKernels.h"
+
+namespace NNUE::Kernels {
+
+    int supported(const KernelSet **sets) {
+        int count = 0;
+        sets[count++] = &scalar;
+
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.1"))
+            sets[count++] = &sse41;
+        if (__builtin_cpu_supports("avx2"))
+            sets[count++] = &avx2;
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+            sets[count++] = &avx512;
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512vnni"))
+            sets[count++] = &avx512Vnni;
+
+        return count;
+    }
+
+    const KernelSet &active() {
+        static const KernelSet *best = [] {
+            const KernelSet *sets[8];
+            int count = supported(sets);
+            return sets[count - 1];
+        }();
+        return *best;
+    }
+}
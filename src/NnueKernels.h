@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Hot NNUE loops, compiled once per instruction set (NnueKernels*.cpp) and picked at startup through CPUID.
+ * Kernel translation units only include this header and intrinsics, so no inline code built
+ * for a newer instruction set can leak into the rest of the binary.
+ */
+namespace NNUE::Kernels {
+
+    struct KernelSet {
+        const char *name;
+
+        // dst = src + sum of add rows - sum of sub rows, width is a multiple of 32, rows are 64-byte aligned
+        void (*updateRows)(const int16_t *src, int16_t *dst,
+                           const int16_t *const *add, int addCount,
+                           const int16_t *const *sub, int subCount,
+                           int width);
+
+        // out = clamp(in >> 1, 0, 127), n is a multiple of 32
+        void (*clipPack)(const int16_t *in, uint8_t *out, int n);
+
+        // indices of non-zero 4-byte chunks of input, n is a multiple of 32, returns their count
+        int (*findNonZero)(const uint8_t *input, int n, uint16_t *nonZero);
+
+        // out[j] += sum over non-zero chunks of input[chunk * 4 + b] * weights[(chunk * outputs + j) * 4 + b]
+        // outputs is a multiple of 16, weights and out are 64-byte aligned
+        void (*sparseAccumulate)(const int8_t *weights,
+                                 const uint8_t *input,
+                                 const uint16_t *nonZero, int nonZeroCount,
+                                 int32_t *out, int outputs);
+
+        // the same product for count inputs of n (at most 1024) bytes at once, out holds outputs values per input,
+        // every weight chunk is loaded once per tile of inputs and skipped when it is zero in all of them
+        void (*sparseAccumulateBatch)(const int8_t *weights,
+                                      const uint8_t *input, int n, int count,
+                                      int32_t *out, int outputs);
+    };
+
+    extern const KernelSet scalar;
+    extern const KernelSet sse41;
+    extern const KernelSet avx2;
+    extern const KernelSet avx512;
+    extern const KernelSet avx512Vnni;
+
+    // best kernel set supported by this cpu
+    const KernelSet &active();
+
+    // all kernel sets this cpu can run, best last
+    int supported(const KernelSet **sets);
+}
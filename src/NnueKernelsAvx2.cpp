@@ -0,0 +1,3 @@
+#define KERNEL_SET avx2
+#define KERNEL_NAME "avx2"
+#include "NnueKernelsImpl.h"
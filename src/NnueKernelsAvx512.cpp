@@ -0,0 +1,3 @@
+#define KERNEL_SET avx512
+#define KERNEL_NAME "avx512"
+#include "NnueKernelsImpl.h"
@@ -0,0 +1,3 @@
+#define KERNEL_SET avx512Vnni
+#define KERNEL_NAME "avx512-vnni"
+#include "NnueKernelsImpl.h"
@@ -0,0 +1,247 @@
+#pragma once
+
+// Included once per instruction set by NnueKernels*.cpp, which are compiled with the matching -m flags
+// and define KERNEL_SET (variable name) and KERNEL_NAME. Only intrinsics and plain loops here, see NnueKernels.h
+
+#include <cstdint>
+#include <immintrin.h>
+#include "NnueKernels.h"
+
+namespace NNUE::Kernels {
+    namespace {
+
+#if defined(__AVX512BW__)
+        using vec_t = __m512i;
+        inline vec_t vecLoad(const void *p) { return _mm512_load_si512(p); }
+        inline void vecStore(void *p, vec_t v) { _mm512_store_si512(p, v); }
+        inline vec_t vecAdd16(vec_t a, vec_t b) { return _mm512_add_epi16(a, b); }
+        inline vec_t vecSub16(vec_t a, vec_t b) { return _mm512_sub_epi16(a, b); }
+        inline vec_t vecAdd32(vec_t a, vec_t b) { return _mm512_add_epi32(a, b); }
+        inline vec_t vecSet32(int32_t v) { return _mm512_set1_epi32(v); }
+        inline uint32_t vecNonZero32(vec_t v) { return _mm512_cmpgt_epi32_mask(v, _mm512_setzero_si512()); }
+#if defined(__AVX512VNNI__)
+        inline vec_t vecDotAdd(vec_t acc, vec_t u8, vec_t i8) { return _mm512_dpbusd_epi32(acc, u8, i8); }
+#else
+        inline vec_t vecDotAdd(vec_t acc, vec_t u8, vec_t i8) {
+            return _mm512_add_epi32(acc, _mm512_madd_epi16(_mm512_maddubs_epi16(u8, i8), _mm512_set1_epi16(1)));
+        }
+#endif
+        inline void vecClipPack(const int16_t *in, uint8_t *out) {
+            // 32 int16 -> 32 uint8
+            vec_t v = _mm512_srai_epi16(_mm512_loadu_si512(in), 1);
+            v = _mm512_min_epi16(_mm512_max_epi16(v, _mm512_setzero_si512()), _mm512_set1_epi16(127));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm512_cvtepi16_epi8(v));
+        }
+#elif defined(__AVX2__)
+        using vec_t = __m256i;
+        inline vec_t vecLoad(const void *p) { return _mm256_load_si256(static_cast<const vec_t *>(p)); }
+        inline void vecStore(void *p, vec_t v) { _mm256_store_si256(static_cast<vec_t *>(p), v); }
+        inline vec_t vecAdd16(vec_t a, vec_t b) { return _mm256_add_epi16(a, b); }
+        inline vec_t vecSub16(vec_t a, vec_t b) { return _mm256_sub_epi16(a, b); }
+        inline vec_t vecAdd32(vec_t a, vec_t b) { return _mm256_add_epi32(a, b); }
+        inline vec_t vecSet32(int32_t v) { return _mm256_set1_epi32(v); }
+        inline uint32_t vecNonZero32(vec_t v) {
+            // inputs are at most 127, so a chunk is non-zero iff it is positive as int32
+            return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, _mm256_setzero_si256())));
+        }
+        inline vec_t vecDotAdd(vec_t acc, vec_t u8, vec_t i8) {
+            return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(u8, i8), _mm256_set1_epi16(1)));
+        }
+        inline void vecClipPack(const int16_t *in, uint8_t *out) {
+            vec_t a = _mm256_srai_epi16(_mm256_loadu_si256(reinterpret_cast<const vec_t *>(in)), 1);
+            vec_t b = _mm256_srai_epi16(_mm256_loadu_si256(reinterpret_cast<const vec_t *>(in + 16)), 1);
+            // packus saturates negatives to 0, lanes are interleaved per 128 bits
+            vec_t packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0b11011000);
+            packed = _mm256_min_epu8(packed, _mm256_set1_epi8(127));
+            _mm256_storeu_si256(reinterpret_cast<vec_t *>(out), packed);
+        }
+#elif defined(__SSE4_1__)
+        using vec_t = __m128i;
+        inline vec_t vecLoad(const void *p) { return _mm_load_si128(static_cast<const vec_t *>(p)); }
+        inline void vecStore(void *p, vec_t v) { _mm_store_si128(static_cast<vec_t *>(p), v); }
+        inline vec_t vecAdd16(vec_t a, vec_t b) { return _mm_add_epi16(a, b); }
+        inline vec_t vecSub16(vec_t a, vec_t b) { return _mm_sub_epi16(a, b); }
+        inline vec_t vecAdd32(vec_t a, vec_t b) { return _mm_add_epi32(a, b); }
+        inline vec_t vecSet32(int32_t v) { return _mm_set1_epi32(v); }
+        inline uint32_t vecNonZero32(vec_t v) {
+            return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, _mm_setzero_si128())));
+        }
+        inline vec_t vecDotAdd(vec_t acc, vec_t u8, vec_t i8) {
+            return _mm_add_epi32(acc, _mm_madd_epi16(_mm_maddubs_epi16(u8, i8), _mm_set1_epi16(1)));
+        }
+        inline void vecClipPack(const int16_t *in, uint8_t *out) {
+            for (int i = 0; i < 32; i += 16) {
+                vec_t a = _mm_srai_epi16(_mm_loadu_si128(reinterpret_cast<const vec_t *>(in + i)), 1);
+                vec_t b = _mm_srai_epi16(_mm_loadu_si128(reinterpret_cast<const vec_t *>(in + i + 8)), 1);
+                vec_t packed = _mm_min_epu8(_mm_packus_epi16(a, b), _mm_set1_epi8(127));
+                _mm_storeu_si128(reinterpret_cast<vec_t *>(out + i), packed);
+            }
+        }
+#endif
+
+#if defined(__SSE4_1__)
+        constexpr int VEC_BYTES = sizeof(vec_t);
+
+        void updateRows(const int16_t *src, int16_t *dst,
+                        const int16_t *const *add, int addCount,
+                        const int16_t *const *sub, int subCount,
+                        int width) {
+            constexpr int LANES = VEC_BYTES / 2;
+            constexpr int REGS = 8;
+
+            // keep a tile of the accumulator in registers while all rows are applied
+            for (int tile = 0; tile < width; tile += REGS * LANES) {
+                int regs = (width - tile) / LANES < REGS ? (width - tile) / LANES : REGS;
+                vec_t sums[REGS];
+                for (int r = 0; r < regs; r++) sums[r] = vecLoad(src + tile + r * LANES);
+                for (int f = 0; f < addCount; f++)
+                    for (int r = 0; r < regs; r++) sums[r] = vecAdd16(sums[r], vecLoad(add[f] + tile + r * LANES));
+                for (int f = 0; f < subCount; f++)
+                    for (int r = 0; r < regs; r++) sums[r] = vecSub16(sums[r], vecLoad(sub[f] + tile + r * LANES));
+                for (int r = 0; r < regs; r++) vecStore(dst + tile + r * LANES, sums[r]);
+            }
+        }
+
+        void clipPack(const int16_t *in, uint8_t *out, int n) {
+            for (int i = 0; i < n; i += 32) {
+                vecClipPack(in + i, out + i);
+            }
+        }
+
+        int findNonZero(const uint8_t *input, int n, uint16_t *nonZero) {
+            constexpr int CHUNKS = VEC_BYTES / 4;
+            int count = 0;
+            for (int i = 0; i < n / VEC_BYTES; i++) {
+                uint32_t mask = vecNonZero32(vecLoad(input + i * VEC_BYTES));
+                while (mask) {
+                    nonZero[count++] = static_cast<uint16_t>(i * CHUNKS + __builtin_ctz(mask));
+                    mask &= mask - 1;
+                }
+            }
+            return count;
+        }
+
+        void sparseAccumulate(const int8_t *weights,
+                              const uint8_t *input,
+                              const uint16_t *nonZero, int nonZeroCount,
+                              int32_t *out, int outputs) {
+            constexpr int MAX_REGS = 128 * 4 / VEC_BYTES; // up to 128 outputs
+            const int regs = outputs * 4 / VEC_BYTES;
+            const auto *inputChunks = reinterpret_cast<const int32_t *>(input);
+
+            vec_t acc[MAX_REGS];
+            for (int j = 0; j < regs; j++) acc[j] = vecLoad(out + j * (VEC_BYTES / 4));
+
+            for (int k = 0; k < nonZeroCount; k++) {
+                int chunkIdx = nonZero[k];
+                vec_t in = vecSet32(inputChunks[chunkIdx]);
+                const int8_t *w = weights + chunkIdx * outputs * 4;
+                for (int j = 0; j < regs; j++) {
+                    acc[j] = vecDotAdd(acc[j], in, vecLoad(w + j * VEC_BYTES));
+                }
+            }
+
+            for (int j = 0; j < regs; j++) vecStore(out + j * (VEC_BYTES / 4), acc[j]);
+        }
+
+        void sparseAccumulateBatch(const int8_t *weights,
+                                   const uint8_t *input, int n, int count,
+                                   int32_t *out, int outputs) {
+            constexpr int TILE = 4;
+            constexpr int MAX_REGS = 128 * 4 / VEC_BYTES;
+            const int regs = outputs * 4 / VEC_BYTES;
+
+            for (int start = 0; start < count; start += TILE) {
+                // a partial tile repeats its last input, only the real ones are stored
+                int size = count - start < TILE ? count - start : TILE;
+                const int32_t *chunks[TILE];
+                for (int t = 0; t < TILE; t++) {
+                    chunks[t] = reinterpret_cast<const int32_t *>(input + (start + (t < size ? t : size - 1)) * n);
+                }
+
+                vec_t acc[TILE][MAX_REGS];
+                for (int t = 0; t < TILE; t++) {
+                    const int32_t *row = out + (start + (t < size ? t : size - 1)) * outputs;
+                    for (int j = 0; j < regs; j++) acc[t][j] = vecLoad(row + j * (VEC_BYTES / 4));
+                }
+
+                for (int c = 0; c < n / 4; c++) {
+                    if ((chunks[0][c] | chunks[1][c] | chunks[2][c] | chunks[3][c]) == 0) continue;
+
+                    vec_t in[TILE];
+                    for (int t = 0; t < TILE; t++) in[t] = vecSet32(chunks[t][c]);
+                    const int8_t *w = weights + c * outputs * 4;
+                    for (int j = 0; j < regs; j++) {
+                        vec_t wj = vecLoad(w + j * VEC_BYTES);
+                        for (int t = 0; t < TILE; t++) acc[t][j] = vecDotAdd(acc[t][j], in[t], wj);
+                    }
+                }
+
+                for (int t = 0; t < size; t++)
+                    for (int j = 0; j < regs; j++) vecStore(out + (start + t) * outputs + j * (VEC_BYTES / 4), acc[t][j]);
+            }
+        }
+#else
+        void updateRows(const int16_t *src, int16_t *dst,
+                        const int16_t *const *add, int addCount,
+                        const int16_t *const *sub, int subCount,
+                        int width) {
+            for (int i = 0; i < width; i++) dst[i] = src[i];
+            for (int f = 0; f < addCount; f++)
+                for (int i = 0; i < width; i++) dst[i] = static_cast<int16_t>(dst[i] + add[f][i]);
+            for (int f = 0; f < subCount; f++)
+                for (int i = 0; i < width; i++) dst[i] = static_cast<int16_t>(dst[i] - sub[f][i]);
+        }
+
+        void clipPack(const int16_t *in, uint8_t *out, int n) {
+            for (int i = 0; i < n; i++) {
+                int v = in[i] >> 1;
+                out[i] = static_cast<uint8_t>(v < 0 ? 0 : (v > 127 ? 127 : v));
+            }
+        }
+
+        int findNonZero(const uint8_t *input, int n, uint16_t *nonZero) {
+            const auto *inputChunks = reinterpret_cast<const int32_t *>(input);
+            int count = 0;
+            for (int i = 0; i < n / 4; i++) {
+                if (inputChunks[i] != 0) nonZero[count++] = static_cast<uint16_t>(i);
+            }
+            return count;
+        }
+
+        void sparseAccumulate(const int8_t *weights,
+                              const uint8_t *input,
+                              const uint16_t *nonZero, int nonZeroCount,
+                              int32_t *out, int outputs) {
+            for (int k = 0; k < nonZeroCount; k++) {
+                int chunkIdx = nonZero[k];
+                const int8_t *w = weights + chunkIdx * outputs * 4;
+                const uint8_t *in = input + chunkIdx * 4;
+                for (int j = 0; j < outputs; j++) {
+                    out[j] += in[0] * w[j * 4] + in[1] * w[j * 4 + 1] + in[2] * w[j * 4 + 2] + in[3] * w[j * 4 + 3];
+                }
+            }
+        }
+
+        // without vector registers there is no weight load to share, each input goes through the sparse loop
+        void sparseAccumulateBatch(const int8_t *weights,
+                                   const uint8_t *input, int n, int count,
+                                   int32_t *out, int outputs) {
+            uint16_t nonZero[1024 / 4];
+            for (int b = 0; b < count; b++) {
+                int nonZeroCount = findNonZero(input + b * n, n, nonZero);
+                sparseAccumulate(weights, input + b * n, nonZero, nonZeroCount, out + b * outputs, outputs);
+            }
+        }
+#endif
+    }
+
+    const KernelSet KERNEL_SET = {
+        KERNEL_NAME,
+        updateRows,
+        clipPack,
+        findNonZero,
+        sparseAccumulate,
+        sparseAccumulateBatch
+    };
+}
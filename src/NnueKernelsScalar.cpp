@@ -0,0 +1,3 @@
+#define KERNEL_SET scalar
+#define KERNEL_NAME "scalar"
+#include "NnueKernelsImpl.h"
@@ -0,0 +1,3 @@
+#define KERNEL_SET sse41
+#define KERNEL_NAME "sse4.1"
+#include "NnueKernelsImpl.h"
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const std::array<const char *, PerfCounters::EVENT_COUNT> EVENT_NAMES = {
+    "cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses", "dTLB-misses"
+};
+
+#ifdef __linux__
+
+static constexpr uint64_t cacheMiss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// type and config of every event
+static const std::array<std::pair<uint32_t, uint64_t>, PerfCounters::EVENT_COUNT> EVENT_CONFIGS = {{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_L1D)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}, // last level on x86
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_DTLB)},
+}};
+
+PerfCounters::PerfCounters() {
+    for (int event = 0; event < EVENT_COUNT; event++) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = EVENT_CONFIGS[event].first;
+        attr.config = EVENT_CONFIGS[event].second;
+        attr.disabled = 1;
+        attr.inherit = 1; // search threads are started by this one
+        attr.exclude_kernel = 1; // allowed with the default perf_event_paranoid of 2
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        fds[event] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fds[event] >= 0) {
+            opened++;
+        } else if (unavailableReason.empty()) {
+            unavailableReason = std::strerror(errno);
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void PerfCounters::start() {
+    for (int event = 0; event < EVENT_COUNT; event++) {
+        if (fds[event] >= 0) {
+            startReadings[event] = read(event);
+            ioctl(fds[event], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop() {
+    for (int event = 0; event < EVENT_COUNT; event++) {
+        if (fds[event] < 0) {
+            continue;
+        }
+        ioctl(fds[event], PERF_EVENT_IOC_DISABLE, 0);
+
+        Reading end = read(event);
+        double value = (double) (end.value - startReadings[event].value);
+        uint64_t enabled = end.enabled - startReadings[event].enabled;
+        uint64_t running = end.running - startReadings[event].running;
+        if (running > 0 && running < enabled) {
+            value *= (double) enabled / (double) running;
+        }
+        totals[event] += value;
+    }
+}
+
+PerfCounters::Reading PerfCounters::read(int event) const {
+    Reading reading;
+    uint64_t values[3];
+    if (::read(fds[event], values, sizeof(values)) == sizeof(values)) {
+        reading = {values[0], values[1], values[2]};
+    }
+    return reading;
+}
+
+#else
+
+PerfCounters::PerfCounters() {
+    fds.fill(-1);
+    unavailableReason = "only supported on Linux";
+}
+
+PerfCounters::~PerfCounters() = default;
+
+void PerfCounters::start() {}
+
+void PerfCounters::stop() {}
+
+PerfCounters::Reading PerfCounters::read(int) const {
+    return {};
+}
+
+#endif
+
+void PerfCounters::reset() {
+    totals.fill(0);
+}
+
+int64_t PerfCounters::total(Event event) const {
+    return fds[event] >= 0 ? (int64_t) totals[event] : -1;
+}
+
+void PerfCounters::report(std::ostream &out, const std::string &label, long long nodes) const {
+    if (!available()) {
+        out << label << " counters: unavailable (" << unavailableReason << ")" << std::endl;
+        return;
+    }
+
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << std::fixed << label << " counters:";
+    for (int event = 0; event < EVENT_COUNT; event++) {
+        out << " " << EVENT_NAMES[event] << " ";
+        if (fds[event] < 0) {
+            out << "n/a";
+            continue;
+        }
+        out << (long long) totals[event] << " (" << std::setprecision(2)
+            << totals[event] / (double) std::max(nodes, 1LL) << "/node)";
+    }
+    if (fds[CYCLES] >= 0 && fds[INSTRUCTIONS] >= 0 && totals[CYCLES] > 0) {
+        out << " ipc " << std::setprecision(2) << totals[INSTRUCTIONS] / totals[CYCLES];
+    }
+    out << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * Hardware performance counters of this process and the threads it starts afterwards (Linux perf_event_open).
+ * Containers and hosts with a strict perf_event_paranoid usually refuse them, then nothing is counted
+ * and report() says why.
+ */
+class PerfCounters {
+ public:
+    enum Event : int {
+        CYCLES,
+        INSTRUCTIONS,
+        L1D_MISSES,
+        LLC_MISSES,
+        BRANCH_MISSES,
+        DTLB_MISSES,
+        EVENT_COUNT
+    };
+
+    // opens the counters disabled, threads started before this are not counted
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    [[nodiscard]] bool available() const { return opened > 0; }
+
+    // counts between start and stop are added to the totals
+    void start();
+    void stop();
+    void reset();
+
+    // -1 if the event could not be opened
+    [[nodiscard]] int64_t total(Event event) const;
+
+    // totals and per node values, one line
+    void report(std::ostream &out, const std::string &label, long long nodes) const;
+
+ private:
+    // raw counter reading, scaled by enabled / running time when the kernel multiplexes the counters
+    struct Reading {
+        uint64_t value = 0;
+        uint64_t enabled = 0;
+        uint64_t running = 0;
+    };
+
+    std::array<int, EVENT_COUNT> fds{};
+    std::array<Reading, EVENT_COUNT> startReadings{};
+    std::array<double, EVENT_COUNT> totals{};
+    int opened = 0;
+    std::string unavailableReason;
+
+    [[nodiscard]] Reading read(int event) const;
+};
@@ -2,6 +2,7 @@
 #include <chrono>
 #include <cassert>
 #include "Driver.h"
+#include "PerfCounters.h"
 
 void Driver::perftTest() {
     assert(perft(5, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", false) == 4864979);
@@ -12,18 +13,22 @@ void Driver::perftTest() {
 }
 int Driver::perft(int depth, const std::string &fen, bool divide = false) {
     auto board = Board::fromFen(fen);
-    auto generator = MoveGenerator();
+    MoveGenerator generator(depth + 1);
 
     //run and time perft
+    PerfCounters counters;
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     int total = perft(depth, 0, divide, board, generator);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
     std::cout << "===== Perft results for " << fen << " =====" << std::endl;
     std::cout << "perft(" << depth << ") finished in: " << duration / 1000.0 << " s. ";
     std::cout << std::fixed << "speed: " << ((float) total / duration) * 1000 << " nodes/s" << std::endl;
     std::cout << "total number of nodes: " << total << std::endl;
+    counters.report(std::cout, "perft", total);
 
     return total;
 }
@@ -38,7 +43,10 @@ int Driver::perft(int maxDepth, int depth, bool divide, Board &board, MoveGenera
     generator.generateMoves(board);
 
     for (int i = 0; i < generator.size(); i++) {
-        board.makeMove(generator[i]);
+        [[maybe_unused]] uint64_t expectedKey = board.keyAfter(generator[i]);
+        Board::UndoInfo undo;
+        board.makeMove(generator[i], undo);
+        assert(board.zobristKey.value == expectedKey);
 
         if (board.isLegal()) {
             int childCount = perft(maxDepth, depth + 1, divide, board, generator);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+// Fixed set of atomic positions used by verification and benchmark commands
+const std::array<std::string, 40> TEST_POSITIONS = {
+    "1nb1qb1r/1p1pnk2/r1p1p3/p5pp/2P5/B1NP4/PP1KPPBP/R2Q2NR b - - 3 1",
+    "1nbqk3/r1pp1pp1/p3p1r1/1p6/3P2Pp/PP2PN1P/5P2/RN1QKB1R w KQ - 1 1",
+    "1r1qkb2/4pp1r/p2p4/1pp2b1p/2P4P/PPN3P1/3P1P2/R1B2K1R b - - 0 1",
+    "1r2kb1r/p1q2pp1/1pbppn2/1Pp4p/P1P1Pn1P/2N2P2/1BQP2P1/RNK2B1R w k - 0 1",
+    "1r2qknr/3bp2p/1n1p2p1/ppp2pPN/1P6/B1PP4/P1R1PP1P/3NKBR1 w - - 0 1",
+    "2b1k2r/2pnqp1p/4p3/3p2p1/6P1/2NP1N1P/2P2P2/2BQK2R b K - 0 1",
+    "2b1k2r/2ppb2p/1pnP2p1/8/6P1/2P1P3/3N4/2BK4 b - - 0 1",
+    "2b4r/2kp4/3b4/2p1pppp/7P/4PPP1/3P4/3RKB1R w - - 0 1",
+    "2bqkb1r/1pp4p/2rppp1n/n4Pp1/p1P5/P3P2P/RPQP2P1/1NBK1BNR w k - 1 1",
+    "2r3nr/1ppk4/3p2pp/p2P2P1/4pP2/PP6/6K1/3R2N1 b - - 0 1",
+    "2r3r1/pb2nk2/1qp3p1/b2p3p/Pp1P1P1R/NPP1P3/R2B4/4KB2 b - - 1 1",
+    "3qk1n1/1pp1b1pr/r4pP1/4p2p/P2pP1RP/1P1P4/4KP2/1R3B2 b - - 4 1",
+    "3qkbnr/2p1p3/rp2P1p1/p6p/3p3P/2N2P2/PPPPK2R/R1B1Q3 b k - 0 1",
+    "4nbr1/3kp3/2p3pp/5p1P/4b1P1/1P1P1P1R/2Q1P3/R3KBN1 w - - 1 1",
+    "r1b1kb2/1pqn3r/3pp2n/pP2P2p/5p2/B1P3PK/P2P3P/RN1Q3R w q - 2 1",
+    "r1b1kb2/p1qp1p2/2p1p3/1p4p1/P3P1Rr/1PP2P1P/2BP4/2BQK3 b q - 1 1",
+    "r1bk4/p2pb3/8/2n3p1/1p4Pp/7P/PPPKPP2/1R2Q3 w - - 8 1",
+    "r1bq4/2b2r2/3p1k2/p3p1pp/4PN1P/1PP4B/RB1Q1P1R/1N2K3 b - - 1 1",
+    "r1bqk1r1/2pp1p1p/6pn/p7/2PP3B/1P2P3/P5PP/R3KBNR w KQq - 1 1",
+    "r1bqk3/pp1p4/4p1rp/2p5/PPP2ppP/R2PPPP1/8/2R1KB2 w - - 1 1",
+    "r1bqkb1r/4pp1p/pp5n/2pp2p1/Pn1N4/2P3PP/1P1PPP2/RNBQKBR1 w Qkq - 0 1",
+    "r1bqkb1r/pppppppp/n7/5n2/4N3/6PP/PPPPPP2/R1BQKBNR b KQkq - 4 1",
+    "r1bqkbnr/p2pp2p/2n2p2/2p3p1/6PP/5N2/PPQPPP2/R1B1KB1R b KQkq - 2 1",
+    "r1bqkbnr/ppppp2p/8/5p2/1nP3p1/N4PPP/PP1PP2R/R1BQKBN1 w Qkq - 3 1",
+    "r2q1k1r/ppp1n1pp/3p1p1B/3P4/1n2pPb1/b3K2P/PPP1P1P1/RNQ2BNR w - - 3 1",
+    "r2qkbnr/2p1p1p1/p1n2p1p/1p1p4/3PP2P/5Q2/PPP2PP1/RNB1KB1R w KQq - 0 1",
+    "r3k1nr/p1p1ppbp/npq5/2Pp4/6P1/1Q1P1P1P/PP2P3/RN2KBNR w KQkq - 3 1",
+    "r4b1r/pbp3p1/n4k1p/1q1Ppn2/1p5P/1P3PP1/P2NP1QR/RB3KN1 b - - 6 1",
+    "rn1q1k2/p1ppnp1r/b4Qpp/4p3/4P3/2P5/PP1P1PPP/RNBK2NR w - - 3 1",
+    "rn1qkbn1/2ppp2r/p3b3/1p3ppp/QP5P/P1P2PP1/3PP3/RNB1KBNR w KQq - 1 1",
+    "rn2kb1r/p1p1qp1p/1p1ppnp1/1N6/6P1/1QP1P2N/PP1PKP1P/1RB2B2 b kq - 2 1",
+    "rn3bn1/p2k2pr/5p1p/1ppppbPQ/1P6/P1PPP3/1BK2P1P/RN3B1R b - - 1 1",
+    "rnb1kb2/1p1p1p2/p3p2p/2p2B2/2P5/4PN1P/1P1P1P2/2BQK3 b q - 1 1",
+    "rnb1kbnr/1p3p1p/1q1p4/p3p1p1/3PPP2/4B3/PPP3PP/RN1QK1NR b KQkq - 1 1",
+    "rnb1kbnr/1p6/p2ppp2/2p4p/2PN4/4P3/PP1PKPPP/R1BQ1B1R w kq - 0 1",
+    "rnb1kbnr/ppp2pp1/3p3p/4p3/1P2P3/1q5P/PBPP1PP1/RNQ1KBNR b KQkq - 0 1",
+    "rnb3r1/1p1kp1b1/p1q3p1/2pp1pPp/2PPnR2/P3PP2/1P1B2BP/RN1QK1N1 b Q - 0 1",
+    "rnbk1b1r/4np2/2p3p1/3pp3/4P2p/5P2/PP1PB1P1/R1BK4 b - - 0 1",
+    "rnbqk2r/1pppbp2/6pn/4p2p/3P4/pP2PQ1N/P1PKBPPP/RNB4R b kq - 2 1",
+    "rnbqkb1r/2p1npp1/p7/1p1p3p/2P5/N3P3/PP1P1PPP/R1BK1BNR b kq - 2 1"
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include "Common.h"
+#include "Move.h"
+#include "Board.h"
+
+/**
+ * Counter moves and continuation history of one search thread.
+ * Indexed by the moves played one and two plies before, pieces by colored type (12) and squares by
+ * their 0..63 index to keep the tables small (1.2 MB)
+ */
+class QuietHistory {
+ public:
+    static constexpr int PIECES = 12;
+    static constexpr int NO_PIECE = -1;
+
+    // piece and destination of a move made on the path from the root
+    struct PlayedMove {
+        int piece = NO_PIECE;
+        int to = 0;
+    };
+
+    static int pieceIndex(const Piece &piece) {
+        return (piece.type() - 1) * 2 + piece.color();
+    }
+    static int square64(int square0x88) {
+        return (square0x88 + (square0x88 & 7)) >> 1;
+    }
+
+    // has to be called before the move is made, a null move breaks the chain
+    void setPlayed(int ply, const Board &board, const Move &move) {
+        auto &played = stack[ply + OFFSET];
+        if (move.flags & MoveFlags::NULL_MOVE) {
+            played.piece = NO_PIECE;
+        } else {
+            played.piece = pieceIndex(board.board[move.from]);
+            played.to = square64(move.to);
+        }
+    }
+
+    // continuation score of a quiet move at ply
+    [[nodiscard]] int score(int ply, const Board &board, const Move &move) const {
+        int piece = board.board[move.from].type() - 1;
+        int to = square64(move.to);
+        int total = 0;
+        for (int back = 0; back < 2; back++) {
+            const auto &previous = stack[ply + OFFSET - 1 - back];
+            if (previous.piece != NO_PIECE) {
+                total += continuation[back][previous.piece][previous.to][piece][to];
+            }
+        }
+        return total;
+    }
+
+    [[nodiscard]] bool isCounter(int ply, const Move &move) const {
+        const auto &previous = stack[ply + OFFSET - 1];
+        return previous.piece != NO_PIECE && counterMoves[previous.piece][previous.to].same(move);
+    }
+
+    // quiet move that cut (positive bonus) or was searched before the one that did (negative)
+    void update(int ply, const Board &board, const Move &move, int bonus) {
+        int piece = board.board[move.from].type() - 1;
+        int to = square64(move.to);
+
+        for (int back = 0; back < 2; back++) {
+            const auto &played = stack[ply + OFFSET - 1 - back];
+            if (played.piece != NO_PIECE) {
+                // gravity keeps every entry within +-MAX_HISTORY_TABLE_VAL
+                auto &entry = continuation[back][played.piece][played.to][piece][to];
+                entry = static_cast<int16_t>(entry + bonus - entry * std::abs(bonus) / MAX_HISTORY_TABLE_VAL);
+            }
+        }
+    }
+
+    void setCounter(int ply, const Move &move) {
+        const auto &previous = stack[ply + OFFSET - 1];
+        if (previous.piece != NO_PIECE) {
+            counterMoves[previous.piece][previous.to] = move;
+        }
+    }
+
+    void clear() {
+        for (auto &played : stack) played = PlayedMove();
+        for (auto &piece : counterMoves) piece.fill(Move());
+        for (auto &back : continuation)
+            for (auto &piece : back)
+                for (auto &square : piece)
+                    for (auto &row : square) row.fill(0);
+    }
+
+ private:
+    // two empty entries in front of the root
+    static constexpr int OFFSET = 2;
+
+    std::array<PlayedMove, MAX_DEPTH + OFFSET> stack{};
+    std::array<std::array<Move, 64>, PIECES> counterMoves{};
+
+    // [plies back - 1][previous piece][previous to][piece type][to]
+    std::array<std::array<std::array<std::array<std::array<int16_t, 64>, 6>, 64>, PIECES>, 2> continuation{};
+};
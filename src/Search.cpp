@@ -1,90 +1,417 @@
+#include <cmath>
 #include <iomanip>
-#include <thread>
+#include <iostream>
 #include "Search.h"
 #include "Metrics.h"
 #include "UCI.h"
 #include "Timer.h"
+#include "Config.h"
 
-void Search::startSearch(const SearchParams &params) {
-    if(searchActive){
-        return;
+Search::Search() {
+    worker = std::make_unique<NativeThread>(THREAD_STACK_SIZE, [this]() { workerLoop(); });
+}
+
+Search::~Search() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        state = State::QUITTING;
+        stopRequested = true;
+        commands.clear();
     }
+    wakeUp.notify_all();
+    worker->join();
+}
 
-    searchActive = true;
-    searchStarted = Timer::getMillis();
-    searchParams = params;
+void Search::workerLoop() {
+    while (true) {
+        std::function<void()> command;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [this]() { return state == State::QUITTING || !commands.empty(); });
+            if (state == State::QUITTING) {
+                return;
+            }
+            command = std::move(commands.front());
+            commands.pop_front();
+        }
+        command();
+    }
+}
 
-    std::thread([&]() { rootSearch(); }).detach();
+void Search::post(std::function<void()> command) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        commands.push_back(std::move(command));
+    }
+    wakeUp.notify_all();
 }
 
-void Search::rootSearch() {
-    auto boardStart = board;
+void Search::go(const SearchParams &params, std::function<void()> prepare) {
+    int stopsBefore, ponderhitsBefore;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopsBefore = stopsIssued;
+        ponderhitsBefore = ponderhitsIssued;
+    }
+    post([this, params, stopsBefore, ponderhitsBefore, prepare = std::move(prepare)]() {
+        prepare();
+        startSearch(params, stopsBefore, ponderhitsBefore);
+    });
+}
+
+void Search::isReady() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (state != State::IDLE && commands.empty()) {
+            std::cout << "readyok" << std::endl;
+            return;
+        }
+    }
+    post([this]() {
+        tTable.wait();
+        std::cout << "readyok" << std::endl;
+    });
+}
 
-    Move bestMove(0, 0, MoveFlags::NULL_MOVE);
-    int bestEval = EVAL_MIN;
+void Search::startSearch(const SearchParams &params, int stopsBefore, int ponderhitsBefore) {
+    // a clear still running in the background (ucinewgame, Hash) is not charged to the clock
+    tTable.wait();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (state == State::QUITTING) {
+            return;
+        }
+        state = State::SEARCHING;
+        // a stop sent while this search was queued still gets a move, just without searching long
+        stopRequested = stopsIssued != stopsBefore;
+
+        // ponderhit reads these from the uci thread
+        searchStarted = Timer::getMillis();
+        searchParams = params;
+        pondering = params.ponder;
+        timeManager.init(params, board.moveColor);
+
+        // same for a ponderhit, the search runs on our clock from the start
+        if (pondering && ponderhitsIssued != ponderhitsBefore) {
+            timeManager.ponderhit(params, board.moveColor, 0);
+            pondering = false;
+        }
+    }
 
-    Timer timer;
     timer.start();
+    metricsAtStart = Metrics::snapshot();
 
-    Metric<NODES_SEARCHED>::set(0);
-    Metric<Q_NODES_SEARCHED>::set(0);
-    Metric<LEAF_NODES_SEARCHED>::set(0);
+    // after a ponder miss the entries of the pondered position stay current, they are one move away
+    if (!lastSearchPondered) {
+        tTable.newSearch();
+    }
+    lastSearchPondered = params.ponder;
 
-    generator.setDepth(0);
+    // threads keep their history between searches, only the count is synced with the option
+    while ((int) threads.size() < Config::threads) {
+        threads.push_back(std::make_unique<SearchThread>(*this, (int) threads.size()));
+    }
+    threads.resize(Config::threads);
 
-    int currentDepth;
-    for (currentDepth = 0; currentDepth < searchParams.depthLimit; currentDepth++) {
-        generator.ageHistory(WHITE);
-        generator.ageHistory(BLACK);
-        generator.clearKillers();
-        generator.generateMoves(board);
-        generator.sortTT(bestMove);
+    for (auto &thread : threads) {
+        thread->setBoard(board);
+    }
+
+    runSearch();
+}
+
+void Search::runSearch() {
+    std::vector<std::unique_ptr<NativeThread>> helpers;
+    for (int i = 1; i < (int) threads.size(); i++) {
+        helpers.push_back(std::make_unique<NativeThread>(THREAD_STACK_SIZE, [this, i]() { threads[i]->rootSearch(); }));
+    }
+
+    threads[0]->rootSearch();
+
+    // infinite and ponder searches report only once they are stopped (or ponderhit arrives)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        wakeUp.wait(lock, [this]() { return stopRequested || (!searchParams.infinite && !pondering); });
+    }
+
+    // helpers run until the main thread is done
+    stopRequested = true;
+    for (auto &helper : helpers) {
+        helper->join();
+    }
+
+    // deepest finished iteration wins, ties go to the better score
+    // (only the main thread orders several lines, so it always reports them)
+    SearchThread *best = threads[0].get();
+    if (Config::multiPv == 1) {
+        for (auto &thread : threads) {
+            if (thread->bestMove.flags & MoveFlags::NULL_MOVE) continue;
+
+            if (thread->completedDepth > best->completedDepth
+                || (thread->completedDepth == best->completedDepth && thread->bestEval > best->bestEval)) {
+                best = thread.get();
+            }
+        }
+    }
+
+    if (best->completedDepth > 0) {
+        UCI::sendInfo({best->completedDepth, best->selDepth, 1, best->bestEval, best->bestPv, nodesSearched(),
+                       timer.getSecondsFromStart(), tTable.hashfull()});
+    }
+
+    if (USE_METRICS) {
+        UCI::sendMetrics(Metrics::difference(Metrics::snapshot(), metricsAtStart));
+    }
 
+    Move reply = ponderMove(*best);
+    UCI::sendResult(best->bestMove, reply);
 
-        int alpha = -1e9;
-        int beta = 1e9;
+    State searching = State::SEARCHING;
+    if (!state.compare_exchange_strong(searching, State::IDLE)) {
+        State stopping = State::STOPPING;
+        state.compare_exchange_strong(stopping, State::IDLE);
+    }
+}
+
+Move Search::ponderMove(const SearchThread &best) {
+    if (best.bestPv.size() > 1) {
+        return best.bestPv[1];
+    }
+
+    // the line was cut by a TT hit, the expected reply can still be in the table
+    Move reply(0, 0, MoveFlags::NULL_MOVE);
+    if (best.bestMove.flags & MoveFlags::NULL_MOVE) {
+        return reply;
+    }
+
+    Board next = board;
+    Board::UndoInfo undo;
+    next.makeMove(best.bestMove, undo);
+    SearchEntry entry;
+    if (!tTable.probe(next.zobristKey.value, entry) || (entry.bestMove.flags & MoveFlags::NULL_MOVE)) {
+        return reply;
+    }
+
+    MoveGenerator moveGenerator;
+    moveGenerator.generateMoves(next);
+    int promotion = entry.bestMove.flags & MoveFlags::PROMOTION_SUBMASK;
+    for (int i = 0; i < moveGenerator.size(); i++) {
+        const auto &move = moveGenerator[i];
+        if (move.from == entry.bestMove.from && move.to == entry.bestMove.to
+            && (move.flags & MoveFlags::PROMOTION_SUBMASK) == promotion && next.tryMakeMove(move, undo)) {
+            next.unmakeMove();
+            reply = move;
+            break;
+        }
+    }
+    return reply;
+}
+
+long long Search::nodesSearched() const {
+    long long total = 0;
+    for (auto &thread : threads) {
+        total += thread->nodesSearched();
+    }
+    return total;
+}
 
-        for (int i = 0; i < generator.size(); i++) {
-            auto move = generator.getSorted(i, board);
+void SearchThread::setBoard(const Board &b) {
+    board = b;
+    nodes = 0;
 
-            if (!board.tryMakeMove(move)) continue;
+    // every thread needs its own accumulators, the network weights are shared
+    nnue = b.nnue ? b.nnue->clone() : nullptr;
+    board.nnue = nnue.get();
+}
 
-            if (bestMove.flags & MoveFlags::NULL_MOVE) {
-                bestMove = generator[i];
+// late move reductions by [depth left][legal move number], 0.75 + ln(depth) * ln(moves) / 2.25
+static const auto LMR_TABLE = [] {
+    std::array<std::array<int, 64>, 64> table{};
+    for (int depth = 1; depth < 64; depth++) {
+        for (int moves = 1; moves < 64; moves++) {
+            table[depth][moves] = static_cast<int>(0.75 + std::log(depth) * std::log(moves) / 2.25);
+        }
+    }
+    return table;
+}();
+
+void SearchThread::rootSearch() {
+    // helpers skip some iterations so that threads spread over different depths
+    static const int skipSize[] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+    static const int skipPhase[] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+    auto boardStart = board;
+
+    bestMove = Move(0, 0, MoveFlags::NULL_MOVE);
+    bestEval = EVAL_MIN;
+    bestPv.clear();
+    completedDepth = 0;
+
+    generator.setDepth(0);
+
+    // legal root moves in the generator's order, re-sorted by score after every line
+    rootMoves.clear();
+    generator.generateMoves(board);
+    for (int i = 0; i < generator.size(); i++) {
+        auto move = generator.getSorted(i, board);
+        if (!board.tryMakeMove(move, stack[0].undo)) continue;
+        board.unmakeMove();
+        rootMoves.emplace_back(move);
+    }
+    int multiPv = std::min<int>(Config::multiPv, (int) rootMoves.size());
+
+    // mated or stalemated, the null move is reported as the best move
+    if (rootMoves.empty()) {
+        bestEval = board.isInCheck() ? matedIn(0) : 0;
+        return;
+    }
+
+    // played if not even the first iteration finishes
+    bestMove = rootMoves[0].move;
+    bestPv.assign(1, bestMove);
+
+    for (int currentDepth = 0; currentDepth < search.searchParams.depthLimit; currentDepth++) {
+        if (id > 0) {
+            int i = (id - 1) % 20;
+            if (((currentDepth + 1 + skipPhase[i]) / skipSize[i]) % 2) {
+                continue;
             }
+        }
 
-            int eval = -alphaBeta(currentDepth, -beta, -alpha);
+        generator.clearKillers();
+        selDepth = 0;
 
-            board.unmakeMove();
+        for (auto &rootMove : rootMoves) {
+            rootMove.previousScore = rootMove.score;
+            rootMove.score = EVAL_MIN;
+        }
 
-            if (!canSearch()) {
-                goto end;
+        // every line searches the moves not taken by the better lines
+        for (int pvIdx = 0; pvIdx < multiPv; pvIdx++) {
+            // aspiration window around the previous score of the line, widened until the score falls inside
+            int previousScore = rootMoves[pvIdx].previousScore;
+            int delta = ASPIRATION_WINDOW;
+            int alpha = -1e9;
+            int beta = 1e9;
+            if (currentDepth + 1 >= ASPIRATION_MIN_DEPTH && !isMateScore(previousScore)) {
+                alpha = previousScore - delta;
+                beta = previousScore + delta;
             }
-            if (i == 0 || eval > bestEval) {
-                bestEval = eval;
-                bestMove = move;
+
+            while (true) {
+                int eval = searchRootMoves(pvIdx, currentDepth, alpha, beta);
+
+                // the completed result is kept when the iteration is cut short
+                if (!canSearch()) {
+                    goto end;
+                }
+
+                int bound;
+                if (eval <= alpha) {
+                    bound = UPPER_BOUND;
+                    beta = (alpha + beta) / 2;
+                    alpha = std::max<int>(eval - delta, -1e9);
+                } else if (eval >= beta) {
+                    bound = LOWER_BOUND;
+                    beta = std::min<int>(eval + delta, 1e9);
+                } else {
+                    break;
+                }
+                delta += delta / 2;
+
+                if (id == 0) {
+                    const auto &rootMove = rootMoves[pvIdx];
+                    UCI::sendInfo({currentDepth + 1, selDepth, pvIdx + 1, rootMove.score, rootMove.pv,
+                                   search.nodesSearched(), search.timer.getSecondsFromStart(),
+                                   search.tTable.hashfull(), bound});
+                }
             }
-            if(eval > alpha){
-                alpha = eval;
+        }
+
+        completedDepth = currentDepth + 1;
+        bestEval = rootMoves[0].score;
+        bestMove = rootMoves[0].move;
+        bestPv = rootMoves[0].pv;
+
+        if (id == 0) {
+            for (int pvIdx = 0; pvIdx < multiPv; pvIdx++) {
+                const auto &rootMove = rootMoves[pvIdx];
+                UCI::sendInfo({currentDepth + 1, selDepth, pvIdx + 1, rootMove.score, rootMove.pv,
+                               search.nodesSearched(), search.timer.getSecondsFromStart(), search.tTable.hashfull()});
             }
-            if (bestEval == EVAL_MAX) {
-                goto end;
+
+            bool bestMoveChanged = completedDepth > 1
+                && (bestMove.from != lastBestMove.from || bestMove.to != lastBestMove.to);
+            lastBestMove = bestMove;
+            if (search.timeManager.stopAfterIteration(Timer::getMillis() - search.searchStarted, bestMoveChanged)) {
+                search.stopRequested = true;
+                break;
             }
+        }
 
+        // a mate found with twice its length of full width depth is taken as the fastest one
+        int mateLimit = search.searchParams.mateLimit;
+        if (bestEval >= MATE_BOUND
+            && (2 * (EVAL_MAX - bestEval) <= completedDepth
+                || (mateLimit > 0 && EVAL_MAX - bestEval <= 2 * mateLimit - 1))) {
+            if (id == 0 && mateLimit > 0) {
+                search.stopRequested = true;
+            }
+            break;
         }
-        UCI::sendInfo(currentDepth + 1, bestEval, bestMove, timer.getSecondsFromStart());
     }
 
     end:
 
-    UCI::sendInfo(currentDepth + 1, bestEval, bestMove, timer.getSecondsFromStart());
-
     board = boardStart;
-    searchActive = false;
-    UCI::sendResult(bestMove);
 }
 
-int Search::alphaBeta(int depthLeft, int alpha, int beta) {
+// searches the root moves from pvIdx on and sorts them by score, the moves that did not improve keep their order,
+// the returned best score is a bound when it falls outside the window
+int SearchThread::searchRootMoves(int pvIdx, int depth, int alpha, int beta) {
+    int bestScore = -1e9;
+
+    for (int i = pvIdx; i < (int) rootMoves.size(); i++) {
+        auto &rootMove = rootMoves[i];
+        const auto &move = rootMove.move;
+
+        quietHistory.setPlayed(0, board, move);
+        board.makeMove(move, stack[0].undo);
+        int eval = -alphaBeta(depth, 1, -beta, -alpha);
+        board.unmakeMove();
+
+        if (!canSearch()) {
+            return bestScore;
+        }
+        if (i == pvIdx || eval > alpha) {
+            rootMove.score = eval;
+        }
+        // a fail low keeps the line of the previous iteration
+        if (eval > alpha) {
+            rootMove.pv.assign(1, move);
+            rootMove.pv.insert(rootMove.pv.end(), pvTable[1] + 1, pvTable[1] + pvLength[1]);
+        }
+
+        bestScore = std::max(bestScore, eval);
+        if (eval >= beta) {
+            break;
+        }
+        if (eval > alpha) {
+            alpha = eval;
+        }
+    }
+
+    std::stable_sort(rootMoves.begin() + pvIdx, rootMoves.end(), [](const RootMove &a, const RootMove &b) {
+        return a.score > b.score;
+    });
+    return bestScore;
+}
+
+int SearchThread::alphaBeta(int depthLeft, int ply, int alpha, int beta) {
+    pvLength[ply] = ply;
+    selDepth = std::max(selDepth, ply);
+
     if (!canSearch()) {
         return 0;
     }
@@ -92,16 +419,25 @@ int Search::alphaBeta(int depthLeft, int alpha, int beta) {
         return 0;
     }
 
+    // mate distance pruning, nothing below can beat a faster mate already found for either side
+    alpha = std::max(alpha, matedIn(ply));
+    beta = std::min(beta, mateIn(ply + 1));
+    if (alpha >= beta) {
+        return alpha;
+    }
+
     int alphaStart = alpha;
-    Metric<NODES_SEARCHED>::inc();
+    bool isPV = beta - alpha != 1;
+    countNode();
     Move ttMove(0, 0, MoveFlags::NULL_MOVE);
 
-    // lookup transposition table
+    // lookup transposition table, PV nodes search on so that the reported line is complete
     auto hash = board.zobristKey.value;
-    if (tTable.at(hash).zobristKey == hash) {
-        auto entry = tTable.at(hash);
-
-        if (entry.depth >= depthLeft) {
+    SearchEntry entry;
+    if (search.tTable.probe(hash, entry)) {
+        Metric<CACHE_HITS>::inc();
+        entry.value = valueFromTT(entry.value, ply);
+        if (entry.depth >= depthLeft && !isPV) {
             if (entry.bound == EXACT) {
                 return entry.value;
             } else if (entry.bound == LOWER_BOUND && entry.value > alpha) {
@@ -118,26 +454,49 @@ int Search::alphaBeta(int depthLeft, int alpha, int beta) {
         ttMove = entry.bestMove;
     }
 
-    //base case
-    if (depthLeft <= 0) {
+    //base case, also where the search stack ends
+    if (depthLeft <= 0 || ply >= MAX_DEPTH - 1) {
+        countNode(-1); // counted again by quiescence
         Metric<LEAF_NODES_SEARCHED>::inc();
-        return quiescence(alpha, beta);
+        return quiescence(ply, alpha, beta);
     }
 
     //some helpers
-    bool isPV = beta - alpha != 1;
+    bool inCheck = board.isInCheck();
 
-    //null move heuristic
+    // static evaluation for the pruning below, not trusted in PV nodes, in check or next to a mate
+    bool canPrune = !isPV && !inCheck && !board.isKingCaptured() && !isMateScore(alpha) && !isMateScore(beta);
+    int &staticEval = stack[ply].staticEval;
+    staticEval = canPrune ? evaluator.evaluateRelative(board) : 0;
+
+    //reverse futility pruning, far enough above beta that a shallow search will not fall below it
+    if (Config::reverseFutilityPruning
+        && canPrune
+        && depthLeft <= REVERSE_FUTILITY_DEPTH
+        && staticEval - REVERSE_FUTILITY_MARGIN * depthLeft >= beta) {
+        return staticEval;
+    }
+
+    //null move heuristic, reduced more at high depth and far above beta when adaptive
+    int nullR = NULL_MOVE_R;
+    if (Config::adaptiveNullMove && canPrune) {
+        nullR = 2 + depthLeft / 4 + std::clamp((staticEval - beta) / 200, 0, 2);
+    }
     if (!board.isKingCaptured()
         && !board.madeNullMove
-        && depthLeft > NULL_MOVE_R
+        && depthLeft > (Config::adaptiveNullMove ? 1 : NULL_MOVE_R)
         && !isPV
         && !board.onlyPawns()
-        && !board.isInCheck()) {
+        && !inCheck
+        // adaptive needs the static evaluation, which is not computed next to a mate
+        && (!Config::adaptiveNullMove || (canPrune && staticEval >= beta))) {
 
-        board.makeMove(Move(1, 1, MoveFlags::NULL_MOVE));
+        quietHistory.setPlayed(ply, board, Move(1, 1, MoveFlags::NULL_MOVE));
+        board.makeMove(Move(1, 1, MoveFlags::NULL_MOVE), stack[ply].undo);
         board.madeNullMove = true;
-        int nullEval = -alphaBeta(depthLeft - NULL_MOVE_R - 1, -beta, -beta + 1);
+        generator.increaseDepth(); // keeps the generator depth equal to the ply below the null move
+        int nullEval = -alphaBeta(std::max(0, depthLeft - nullR - 1), ply + 1, -beta, -beta + 1);
+        generator.decreaseDepth();
         board.unmakeMove();
         board.madeNullMove = false;
         if (nullEval >= beta) {
@@ -160,21 +519,61 @@ int Search::alphaBeta(int depthLeft, int alpha, int beta) {
     int bestMoveIdx = 0;
     int value = EVAL_MIN;
 
+    // quiet moves that did not cut, they get a malus when a later move does
+    Move quietsTried[64];
+    int quietCount = 0;
+
     for (int i = 0; i < generator.size(); i++) {
         auto move = generator.getSorted(i, board);
 
-        if(!board.tryMakeMove(move)) continue;
+        // the child's bucket loads while the move is made and checked for legality
+        search.tTable.prefetch(board.keyAfter(move));
+
+        quietHistory.setPlayed(ply, board, move);
+        if(!board.tryMakeMove(move, stack[ply].undo)) continue;
+
+        bool quiet = !(move.flags & (MoveFlags::CAPTURE | MoveFlags::PROMOTION_SUBMASK));
+        bool givesCheck = board.isInCheck();
+
+        // shallow pruning of late quiet moves, never the first move and never checks
+        if (canPrune && quiet && !givesCheck && legalMovesFound > 0) {
+            bool lateMove = Config::lateMovePruning
+                && depthLeft <= LATE_MOVE_PRUNING_DEPTH
+                && quietCount >= 3 + depthLeft * depthLeft;
+            bool futile = Config::futilityPruning
+                && depthLeft <= FUTILITY_DEPTH
+                && staticEval + FUTILITY_MARGIN * depthLeft <= alpha;
+            if (lateMove || futile) {
+                board.unmakeMove();
+                continue;
+            }
+        }
 
         legalMovesFound++;
 
+        // late move reductions for quiet moves ordered after the first few
+        int reduction = 0;
+        if (Config::lateMoveReductions
+            && depthLeft >= LMR_MIN_DEPTH
+            && legalMovesFound > 3
+            && quiet
+            && !inCheck
+            && !givesCheck) {
+            reduction = LMR_TABLE[std::min(depthLeft, 63)][std::min(legalMovesFound, 63)] - isPV;
+            reduction = std::clamp(reduction, 0, depthLeft - 2);
+        }
+
         // Principal variation search
         int eval;
-        if (i == 0) {
-            eval = -alphaBeta(depthLeft - 1, -beta, -alpha);
+        if (legalMovesFound == 1) {
+            eval = -alphaBeta(depthLeft - 1, ply + 1, -beta, -alpha);
         } else {
-            eval = -alphaBeta(depthLeft - 1, -alpha - 1, -alpha);
+            eval = -alphaBeta(depthLeft - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+            if (reduction > 0 && eval > alpha) {
+                eval = -alphaBeta(depthLeft - 1, ply + 1, -alpha - 1, -alpha);
+            }
             if (alpha < eval && eval < beta) {
-                eval = -alphaBeta(depthLeft - 1, -beta, -alpha);
+                eval = -alphaBeta(depthLeft - 1, ply + 1, -beta, -alpha);
             }
         }
 
@@ -185,67 +584,129 @@ int Search::alphaBeta(int depthLeft, int alpha, int beta) {
             value = eval;
             if (eval > alpha) {
                 alpha = value;
+                updatePv(ply, move);
             }
         }
 
         //beta cutoff
         if (alpha >= beta) {
-            generator.updateHistory(board.moveColor, move, depthLeft);
             generator.markKiller(i);
+            if (quiet) {
+                int bonus = historyBonus(depthLeft);
+                generator.updateHistory(board.moveColor, move, bonus);
+                quietHistory.update(ply, board, move, bonus);
+                quietHistory.setCounter(ply, move);
+                for (int j = 0; j < quietCount; j++) {
+                    generator.updateHistory(board.moveColor, quietsTried[j], -bonus);
+                    quietHistory.update(ply, board, quietsTried[j], -bonus);
+                }
+            }
             break;
         }
+
+        if (quiet && quietCount < 64) {
+            quietsTried[quietCount++] = move;
+        }
     }
 
     //no legal moves, tie or lost
     if (legalMovesFound == 0) {
         generator.decreaseDepth();
-        return board.isInCheck() || board.isKingCaptured() ? EVAL_MIN : 0;
+        return board.isInCheck() || board.isKingCaptured() ? matedIn(ply) : 0;
     }
 
-    //save move to TT
-    SearchEntry ttEntry;
-    ttEntry.value = value;
-    ttEntry.bestMove = generator[bestMoveIdx];
-    ttEntry.depth = depthLeft;
-    ttEntry.zobristKey = hash;
-    if (value <= alphaStart) {
-        ttEntry.bound = UPPER_BOUND;
-    } else if (value >= beta) {
-        ttEntry.bound = LOWER_BOUND;
-    } else {
-        ttEntry.bound = EXACT;
-    }
+    //save move to TT, results below an aborted search are garbage
+    if (!search.stopRequested.load(std::memory_order_relaxed)) {
+        SearchEntry ttEntry;
+        ttEntry.value = valueToTT(value, ply);
+        ttEntry.bestMove = generator[bestMoveIdx];
+        ttEntry.depth = depthLeft;
+        ttEntry.zobristKey = hash;
+        if (value <= alphaStart) {
+            ttEntry.bound = UPPER_BOUND;
+        } else if (value >= beta) {
+            ttEntry.bound = LOWER_BOUND;
+        } else {
+            ttEntry.bound = EXACT;
+        }
 
-    if (tTable.at(hash).zobristKey == 0) {
-        Metric<TT_WRITTEN>::inc();
+        search.tTable.store(hash, ttEntry);
     }
-    tTable.store(hash, ttEntry);
 
     generator.decreaseDepth();
     return value;
 }
 
-int Search::quiescence(int alpha, int beta) {
+int SearchThread::quiescence(int ply, int alpha, int beta) {
+    pvLength[ply] = ply;
+    selDepth = std::max(selDepth, ply);
+    countNode();
     Metric<Q_NODES_SEARCHED>::inc();
 
     if (!canSearch()) {
         return 0;
     }
 
+    // no frame left for the moves, a line this long only gets the static evaluation
+    if (ply >= MAX_DEPTH - 1) {
+        int eval = evaluator.evaluateRelative(board);
+        return eval == EVAL_MIN ? matedIn(ply) : eval;
+    }
+
+    // mate distance pruning
+    alpha = std::max(alpha, matedIn(ply));
+    beta = std::min(beta, mateIn(ply + 1));
+    if (alpha >= beta) {
+        return alpha;
+    }
+
     bool inCheck = board.isInCheck();
+    int ttDepth = inCheck ? DEPTH_QS_CHECKS : DEPTH_QS_NO_CHECKS;
+    Move ttMove(0, 0, MoveFlags::NULL_MOVE);
+
+    // lookup transposition table, main search entries are deeper and always usable
+    auto hash = board.zobristKey.value;
+    SearchEntry entry;
+    if (search.tTable.probe(hash, entry)) {
+        Metric<CACHE_HITS>::inc();
+        entry.value = valueFromTT(entry.value, ply);
+        if (entry.depth >= ttDepth
+            && (entry.bound == EXACT
+                || (entry.bound == LOWER_BOUND && entry.value >= beta)
+                || (entry.bound == UPPER_BOUND && entry.value <= alpha))) {
+            return entry.value;
+        }
+        ttMove = entry.bestMove;
+    }
+
+    SearchEntry ttEntry;
+    ttEntry.zobristKey = hash;
+    ttEntry.depth = ttDepth;
+    ttEntry.bestMove = Move(0, 0, MoveFlags::NULL_MOVE);
 
-    //Standing Pat
+    //Standing Pat, a lost position (king captured or no way out of check) ends the line
     int bestScore = evaluator.evaluateRelative(board);
+    if (bestScore == EVAL_MIN) {
+        return matedIn(ply);
+    }
     if (bestScore > alpha) {
         alpha = bestScore;
     }
     if (bestScore >= beta) {
+        ttEntry.value = valueToTT(bestScore, ply);
+        ttEntry.bound = LOWER_BOUND;
+        search.tTable.store(hash, ttEntry);
         return bestScore;
     }
 
+    int alphaStart = alpha;
+
     generator.increaseDepth();
     generator.generateMoves(board);
 
+    //best capture from TT goes first
+    generator.sortTT(ttMove, !inCheck);
+
     for (int i = 0; i < generator.size(); i++) {
         auto move = generator.getSorted(i, board);
 
@@ -253,12 +714,20 @@ int Search::quiescence(int alpha, int beta) {
             break;
         }
 
-        if(!board.tryMakeMove(move)) continue;
+        quietHistory.setPlayed(ply, board, move);
+        if(!board.tryMakeMove(move, stack[ply].undo)) continue;
 
-        int score = -quiescence(-beta, -alpha);
+        int score = -quiescence(ply + 1, -beta, -alpha);
         board.unmakeMove();
 
         if (score >= beta) {
+            if (!search.stopRequested.load(std::memory_order_relaxed)) {
+                ttEntry.value = valueToTT(beta, ply);
+                ttEntry.bound = LOWER_BOUND;
+                ttEntry.bestMove = move;
+                search.tTable.store(hash, ttEntry);
+            }
+
             generator.decreaseDepth();
             return beta;
         }
@@ -267,45 +736,98 @@ int Search::quiescence(int alpha, int beta) {
         }
         if(score > bestScore){
             bestScore = score;
+            ttEntry.bestMove = move;
         }
     }
 
+    // results below an aborted search are garbage
+    if (!search.stopRequested.load(std::memory_order_relaxed)) {
+        ttEntry.value = valueToTT(bestScore, ply);
+        ttEntry.bound = bestScore > alphaStart ? EXACT : UPPER_BOUND;
+        search.tTable.store(hash, ttEntry);
+    }
+
     generator.decreaseDepth();
     return bestScore;
 }
 
-bool Search::canSearch() {
-    if (!searchActive) {
+void SearchThread::updatePv(int ply, const Move &move) {
+    // the line below this node, the length is kept as the index one past its last move
+    pvTable[ply][ply] = move;
+    int length = ply + 1 < MAX_DEPTH ? pvLength[ply + 1] : ply + 1;
+    for (int i = ply + 1; i < length; i++) {
+        pvTable[ply][i] = pvTable[ply + 1][i];
+    }
+    pvLength[ply] = length;
+}
+
+bool SearchThread::canSearch() {
+    if (search.stopRequested.load(std::memory_order_relaxed)) {
         return false;
     }
 
-    long long nodesSearched = Metric<NODES_SEARCHED>::get()
-        - Metric<LEAF_NODES_SEARCHED>::get()
-        + Metric<Q_NODES_SEARCHED>::get();
+    // limits are checked by the main thread, helpers only follow its stop
+    if (id != 0) {
+        return true;
+    }
+
+    const auto &searchParams = search.searchParams;
+    long long ownNodes = nodesSearched();
 
-    //if over the node limit
-    if(searchParams.nodeLimit > 0 && nodesSearched >= searchParams.nodeLimit){
-        searchActive = false;
+    //if over the node limit (summing all threads only every 2^10 nodes when helpers run)
+    if(searchParams.nodeLimit > 0
+        && (search.threads.size() == 1 || (ownNodes & ((1 << 10) - 1)) == 0)
+        && search.nodesSearched() >= searchParams.nodeLimit){
+        search.stopRequested = true;
         return false;
     }
 
-    //if over the time limit, (only check every 2^14 nodes for smaller overhead)
-    if(searchParams.timeLimit > 0
-        && (nodesSearched & ((1 << 14) - 1)) == 0
-        && Timer::getMillis() - searchStarted >= searchParams.timeLimit){
-        searchActive = false;
+    //if over the hard time limit, (only check every 2^11 nodes for smaller overhead)
+    //the first iteration always finishes so that there is a move to play
+    if(completedDepth > 0
+        && (ownNodes & ((1 << 11) - 1)) == 0
+        && search.timeManager.hardLimitReached(Timer::getMillis() - search.searchStarted)){
+        search.stopRequested = true;
         return false;
     }
 
     return true;
 }
 
-void Search::resetCache() {
-    Metric<TT_WRITTEN>::set(0);
-    tTable.clear();
+void SearchThread::resetCache() {
     generator.clearHistory();
     generator.clearKillers();
+    quietHistory.clear();
+}
+
+void Search::resetCache() {
+    tTable.clear();
+    for (auto &thread : threads) {
+        thread->resetCache();
+    }
 }
 void Search::killSearch() {
-    searchActive = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopsIssued++;
+        stopRequested = true;
+        State searching = State::SEARCHING;
+        state.compare_exchange_strong(searching, State::STOPPING);
+    }
+    wakeUp.notify_all();
+}
+
+void Search::ponderhit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // kept for a ponder search that is still queued
+        if (state != State::SEARCHING || !pondering) {
+            ponderhitsIssued++;
+            return;
+        }
+        // the rest of the search runs on our clock
+        timeManager.ponderhit(searchParams, board.moveColor, Timer::getMillis() - searchStarted);
+        pondering = false;
+    }
+    wakeUp.notify_all();
 }
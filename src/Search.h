@@ -1,32 +1,150 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "Board.h"
 #include "MoveGenerator.h"
+#include "SearchStack.h"
 #include "Evaluator.h"
 #include "TranspositionTable.h"
+#include "TimeManager.h"
+#include "NativeThread.h"
 #include "Metrics.h"
+#include "Timer.h"
 
-class Search {
+class Search;
+
+struct RootMove {
+    explicit RootMove(const Move &move) : move(move) {}
+
+    Move move;
+    int score = EVAL_MIN;
+    int previousScore = EVAL_MIN; // of the last iteration, centers the aspiration window
+    std::vector<Move> pv;
+};
+
+/**
+ * One lazy SMP search thread, everything except the transposition table is private to it
+ */
+class SearchThread {
  public:
-    Search() : board(Board::fromFen(DEFAULT_FEN)) {}
+    SearchThread(Search &search, int id)
+        : search(search), id(id), board(Board::fromFen(DEFAULT_FEN)), generator(stack) {
+        generator.setQuietHistory(&quietHistory);
+    }
 
-    void setBoard(const Board &b) {board = b;}
-    void startSearch(const SearchParams &params);
+    void setBoard(const Board &b);
+    void rootSearch();
     void resetCache();
-    void killSearch();
 
-    TranspositionTable<SearchEntry> tTable{};
+    // written by this thread only, read by the main thread for reporting and node limits
+    [[nodiscard]] long long nodesSearched() const { return nodes.load(std::memory_order_relaxed); }
+
+    // result of the last completed iteration
+    Move bestMove;
+    int bestEval = EVAL_MIN;
+    std::vector<Move> bestPv;
+    int completedDepth = 0;
+    int selDepth = 0;
 
  private:
+    Search &search;
+    const int id;
     Board board;
+    std::unique_ptr<NNUE::Network> nnue;
+    SearchStack stack;
     MoveGenerator generator;
+    QuietHistory quietHistory;
     Evaluator evaluator;
+    std::atomic<long long> nodes{0};
+
+    // legal root moves, the first MultiPV of them are the reported lines
+    std::vector<RootMove> rootMoves;
+    Move lastBestMove;
+
+    // triangular principal variation table, row ply holds the line starting at that ply
+    Move pvTable[MAX_DEPTH][MAX_DEPTH];
+    int pvLength[MAX_DEPTH]{};
+
+    int searchRootMoves(int pvIdx, int depth, int alpha, int beta);
+    int quiescence(int ply, int alpha, int beta);
+    int alphaBeta(int depthLeft, int ply, int alpha, int beta);
+    void updatePv(int ply, const Move &move);
+    static int historyBonus(int depth) { return std::min(HISTORY_BONUS_SCALE * depth * depth, MAX_HISTORY_BONUS); }
+    [[nodiscard]] bool canSearch();
+    void countNode(int n = 1) { nodes.store(nodes.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+};
+
+/**
+ * Searches run one after another on a long-lived worker thread, uci commands that touch the search state
+ * are queued to it so that they are applied between searches
+ */
+class Search {
+ public:
+    enum class State {
+        IDLE,
+        SEARCHING,
+        STOPPING,
+        QUITTING
+    };
+
+    Search();
+    ~Search();
+
+    // queue a search, prepare runs on the worker right before it (set the board there)
+    void go(const SearchParams &params, std::function<void()> prepare);
+
+    // queue a command, it runs once everything queued before it is done
+    void post(std::function<void()> command);
+
+    // readyok once the queued commands are applied, right away while searching with nothing queued
+    void isReady();
+
+    // stop the running search and the ones queued before this call, takes effect at the next node
+    void killSearch();
+    void ponderhit();
+
+    // worker only (from a posted command)
+    void setBoard(const Board &b) {board = b;}
+    void resetCache();
+
+    [[nodiscard]] State getState() const { return state; }
+
+    // of the running or the last search, all threads
+    [[nodiscard]] long long nodesSearched() const;
+
+    TranspositionTable tTable{};
+
+ private:
+    friend class SearchThread;
+
+    Board board = Board::fromFen(DEFAULT_FEN);
+    std::vector<std::unique_ptr<SearchThread>> threads;
     SearchParams searchParams{};
+    TimeManager timeManager;
     long long searchStarted = 0;
-    bool searchActive = false;
+    Timer timer;
+    Metrics::Snapshot metricsAtStart{};
+    std::atomic<bool> stopRequested = false;
+    std::atomic<bool> pondering = false;
+    bool lastSearchPondered = false;
 
-    int quiescence(int alpha, int beta);
-    int alphaBeta(int depthLeft, int alpha, int beta);
-    void rootSearch();
-    [[nodiscard]] bool canSearch();
-};
\ No newline at end of file
+    // worker state, the queue and the waits below are guarded by mutex
+    std::atomic<State> state = State::IDLE;
+    std::deque<std::function<void()>> commands;
+    int stopsIssued = 0;
+    int ponderhitsIssued = 0; // only the ones that found no pondering search
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::unique_ptr<NativeThread> worker;
+
+    void workerLoop();
+    void startSearch(const SearchParams &params, int stopsBefore, int ponderhitsBefore);
+    void runSearch();
+    [[nodiscard]] Move ponderMove(const SearchThread &best);
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include "Common.h"
+#include "Move.h"
+#include "Board.h"
+
+/**
+ * Everything the search keeps per ply, frame ply belongs to the node that far from the root:
+ * its generated moves with their capture scores, killers, static evaluation and the undo
+ * information of the move currently searched from it
+ */
+struct PlyFrame {
+    std::array<Move, MAX_MOVES> moves;
+    std::array<int, MAX_MOVES> captureScores; // mvv-lva
+    int size;
+    int sorted;
+    std::array<Move, KILLER_MOVES_N> killers;
+    int staticEval;
+    Board::UndoInfo undo;
+};
+
+/**
+ * Contiguous frames of one search thread (MAX_DEPTH plies, about 530 KB), or a few for a standalone move generator
+ */
+class SearchStack {
+ public:
+    explicit SearchStack(int plies = MAX_DEPTH) : plies(plies), frames(std::make_unique<PlyFrame[]>(plies)) {}
+
+    PlyFrame &operator[](int ply) {
+        return frames[ply];
+    }
+    [[nodiscard]] int size() const {
+        return plies;
+    }
+
+ private:
+    int plies;
+    std::unique_ptr<PlyFrame[]> frames;
+};
@@ -0,0 +1,41 @@
+#include <future>
+#include <iostream>
+#include <sstream>
+#include "Driver.h"
+
+void Driver::searchTest() {
+    // positions without legal moves, the search has to answer with the null move
+    const std::array<std::pair<std::string, std::string>, 2> positions = {{
+        {"checkmate", "k7/1Q6/8/8/8/8/8/7K b - - 0 1"},
+        {"stalemate", "k7/8/1Q6/8/8/8/8/7K b - - 0 1"},
+    }};
+
+    std::cout << "===== Search test =====" << std::endl;
+
+    bool passed = true;
+    Search search;
+    for (const auto &[name, fen] : positions) {
+        Board board = Board::fromFen(fen);
+        SearchParams params{};
+        params.depthLimit = 4;
+
+        // the search's own output is checked instead of printed
+        std::ostringstream output;
+        auto *console = std::cout.rdbuf(output.rdbuf());
+
+        search.go(params, [&search, &board]() {
+            search.setBoard(board);
+        });
+        std::promise<void> done;
+        search.post([&done] { done.set_value(); });
+        done.get_future().wait();
+
+        std::cout.rdbuf(console);
+
+        bool nullMove = output.str().find("bestmove a1a1") != std::string::npos;
+        passed &= nullMove;
+        std::cout << name << ": " << (nullMove ? "bestmove a1a1" : "unexpected result") << std::endl;
+    }
+
+    std::cout << (passed ? "OK" : "FAILED") << std::endl;
+}
@@ -0,0 +1,85 @@
+#include <iomanip>
+#include <random>
+#include <thread>
+#include "Driver.h"
+#include "Timer.h"
+
+void Driver::ttStressTest(int threads, double seconds) {
+    // tiny table and key pool so that threads constantly race on the same buckets
+    const int tableMegabytes = 1;
+    const int keyPoolSize = 1 << 16;
+
+    TranspositionTable table(tableMegabytes);
+    table.wait();
+
+    // every field of an entry is derived from its key, so a torn read shows up as a mismatch
+    auto entryForKey = [](uint64_t key) {
+        SearchEntry entry;
+        entry.value = static_cast<int>(key % (2 * EVAL_MAX)) - EVAL_MAX;
+        entry.depth = static_cast<int>((key >> 20) % MAX_DEPTH);
+        entry.bound = static_cast<int>((key >> 30) % 3);
+        // board squares only, from == to is how the table stores no move
+        int from = static_cast<int>(key >> 40) & 0x77;
+        int to = (from + 1 + static_cast<int>((key >> 50) % 127)) & 0x77;
+        if (to == from) {
+            to ^= 1;
+        }
+        int promotion = static_cast<int>(key >> 44) & MoveFlags::PROMOTION_SUBMASK;
+        entry.bestMove = Move(from, to, promotion);
+        return entry;
+    };
+
+    // distinct 16-bit tags, so a hit can only come from the key's own entry
+    std::vector<uint64_t> keys(keyPoolSize);
+    std::mt19937_64 keyGenerator(42);
+    for (int i = 0; i < keyPoolSize; i++) {
+        keys[i] = (keyGenerator() & ~0xFFFFULL) | i;
+    }
+
+    std::atomic<bool> running = true;
+    std::atomic<long long> totalProbes = 0;
+    std::atomic<long long> totalHits = 0;
+    std::atomic<long long> totalCorrupted = 0;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            std::mt19937 random(t);
+            long long probes = 0, hits = 0, corrupted = 0;
+
+            while (running.load(std::memory_order_relaxed)) {
+                uint64_t key = keys[random() % keyPoolSize];
+                if (random() & 1) {
+                    table.store(key, entryForKey(key));
+                    continue;
+                }
+
+                SearchEntry entry;
+                probes++;
+                if (table.probe(key, entry)) {
+                    hits++;
+                    auto expected = entryForKey(key);
+                    corrupted += entry.value != expected.value
+                        || entry.depth != expected.depth
+                        || entry.bound != expected.bound
+                        || !entry.bestMove.same(expected.bestMove)
+                        || entry.bestMove.flags != expected.bestMove.flags;
+                }
+            }
+
+            totalProbes += probes;
+            totalHits += hits;
+            totalCorrupted += corrupted;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    running = false;
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    std::cout << "===== Transposition table stress test, " << threads << " threads, " << seconds << " s =====" << std::endl;
+    std::cout << "probes: " << totalProbes << ", hits: " << totalHits << ", corrupted: " << totalCorrupted << std::endl;
+    std::cout << (totalCorrupted == 0 ? "OK" : "FAILED") << std::endl;
+}
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include "TimeManager.h"
+#include "Config.h"
+
+void TimeManager::init(const SearchParams &params, int color) {
+    lastIterationEnd = 0;
+    lastIterationTime = 0;
+    instability = 0;
+
+    // a ponder search has no limits until the opponent plays the expected move
+    setLimits(params, color, params.ponder ? -1 : 0);
+}
+
+void TimeManager::ponderhit(const SearchParams &params, int color, long long elapsed) {
+    setLimits(params, color, elapsed);
+}
+
+void TimeManager::setLimits(const SearchParams &params, int color, long long offset) {
+    long long soft = 0;
+    long long hard = 0;
+
+    long long time = color == WHITE ? params.whiteTime : params.blackTime;
+    long long increment = color == WHITE ? params.whiteIncrement : params.blackIncrement;
+
+    if (offset < 0 || params.infinite) {
+        // no limits
+    } else if (params.timeLimit > 0) {
+        // fixed time per move, nothing to plan
+        hard = params.timeLimit;
+    } else if (time > 0) {
+        // atomic games are short, expect fewer moves than in standard chess when the GUI does not tell
+        int movesToGo = params.movesToGo > 0 ? std::min(params.movesToGo, 50) : 25;
+        long long available = std::max(1LL, time - Config::moveOverhead);
+
+        hard = std::max(1LL, std::min(available * 4 / 5, (available / movesToGo + increment) * 5));
+        soft = std::max(1LL, std::min(available / movesToGo + increment * 3 / 4, hard / 2));
+        if (movesToGo == 1) {
+            soft = hard;
+        }
+    }
+
+    // limits count from the start of the search, after ponderhit the clock only runs from then on
+    softLimit = soft > 0 ? soft + offset : 0;
+    hardLimit = hard > 0 ? hard + offset : 0;
+}
+
+bool TimeManager::stopAfterIteration(long long elapsed, bool bestMoveChanged) {
+    long long iterationTime = elapsed - lastIterationEnd;
+
+    // effective branching factor of the last two iterations predicts the next one
+    double branchingFactor = 2;
+    if (lastIterationTime > 0) {
+        branchingFactor = std::clamp((double) iterationTime / (double) lastIterationTime, 1.5, 6.0);
+    }
+    lastIterationEnd = elapsed;
+    lastIterationTime = std::max(1LL, iterationTime);
+
+    if (softLimit <= 0) {
+        return false;
+    }
+
+    // spend up to twice the planned time while the best move keeps changing
+    instability = instability / 2 + (bestMoveChanged ? 1 : 0);
+    double optimum = (double) softLimit * (1 + std::min(instability, 2.0) / 2);
+
+    if ((double) elapsed >= optimum) {
+        return true;
+    }
+
+    // an iteration cut by the hard limit is wasted
+    double predicted = (double) lastIterationTime * branchingFactor;
+    return (double) elapsed + predicted > (double) hardLimit;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include "Common.h"
+
+/**
+ * Splits the clock of a timed game into limits for one search
+ * soft limit - no new iteration starts after it (stretched while the best move is unstable)
+ * hard limit - the search is aborted when it is reached
+ */
+class TimeManager {
+ public:
+    void init(const SearchParams &params, int color);
+
+    // the expected move was played, elapsed is the time spent pondering
+    void ponderhit(const SearchParams &params, int color, long long elapsed);
+
+    // called by the main thread after every completed iteration
+    [[nodiscard]] bool stopAfterIteration(long long elapsed, bool bestMoveChanged);
+
+    [[nodiscard]] bool hardLimitReached(long long elapsed) const { return hardLimit > 0 && elapsed >= hardLimit; }
+    [[nodiscard]] long long getSoftLimit() const { return softLimit; }
+    [[nodiscard]] long long getHardLimit() const { return hardLimit; }
+
+ private:
+    // milliseconds from the start of the search, 0 means no limit (set by the uci thread on ponderhit)
+    std::atomic<long long> softLimit = 0;
+    std::atomic<long long> hardLimit = 0;
+
+    long long lastIterationEnd = 0;
+    long long lastIterationTime = 0;
+    double instability = 0;
+
+    void setLimits(const SearchParams &params, int color, long long offset);
+};
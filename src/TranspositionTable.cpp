@@ -0,0 +1,136 @@
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include "TranspositionTable.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+TranspositionTable::TranspositionTable(int megabytes) {
+    allocate(megabytes);
+    if (!mapped) {
+        clear();
+    }
+}
+
+TranspositionTable::~TranspositionTable() {
+    wait();
+    release();
+}
+
+void TranspositionTable::allocate(int megabytes) {
+    numBuckets = static_cast<uint64_t>(megabytes) * 1024 * 1024 / sizeof(Bucket);
+    allocatedBytes = numBuckets * sizeof(Bucket);
+    Metric<TT_ENTRIES>::set(static_cast<int64_t>(numBuckets) * BUCKET_SIZE);
+
+#ifdef __linux__
+    // anonymous pages are only backed on first touch, so mapping even a 64 GB table is instant.
+    // Map 2 MB extra to align the table for transparent huge pages, which cut TLB misses on random probes
+    const size_t hugePage = 2 * 1024 * 1024;
+    size_t mappedBytes = allocatedBytes + hugePage;
+    void *region = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region != MAP_FAILED) {
+        auto start = reinterpret_cast<uintptr_t>(region);
+        auto aligned = (start + hugePage - 1) & ~(hugePage - 1);
+        if (aligned > start) {
+            munmap(region, aligned - start);
+        }
+        size_t tail = start + mappedBytes - (aligned + allocatedBytes);
+        if (tail > 0) {
+            munmap(reinterpret_cast<void *>(aligned + allocatedBytes), tail);
+        }
+
+        buckets = reinterpret_cast<Bucket *>(aligned);
+        madvise(buckets, allocatedBytes, MADV_HUGEPAGE);
+        mapped = true;
+        return;
+    }
+#endif
+
+#ifdef _WIN32
+    buckets = static_cast<Bucket *>(_aligned_malloc(allocatedBytes, alignof(Bucket)));
+#else
+    buckets = static_cast<Bucket *>(std::aligned_alloc(alignof(Bucket), allocatedBytes));
+#endif
+    if (!buckets) {
+        std::cout << "Could not allocate " << megabytes << " MB for the transposition table" << std::endl;
+        exit(1);
+    }
+}
+
+void TranspositionTable::release() {
+    if (!buckets) {
+        return;
+    }
+
+    if (mapped) {
+#ifdef __linux__
+        munmap(buckets, allocatedBytes);
+#endif
+    } else {
+#ifdef _WIN32
+        _aligned_free(buckets);
+#else
+        std::free(buckets);
+#endif
+    }
+    buckets = nullptr;
+    mapped = false;
+}
+
+void TranspositionTable::clear() {
+    wait();
+    pending = std::thread([this] { clearBuckets(); });
+}
+
+void TranspositionTable::resize() {
+    wait();
+    // the old mapping is dropped and replaced in the background as well
+    pending = std::thread([this] {
+        release();
+        allocate(Config::transpositionTableSize);
+        if (!mapped) {
+            clearBuckets();
+        }
+    });
+}
+
+void TranspositionTable::wait() {
+    if (pending.joinable()) {
+        pending.join();
+    }
+}
+
+void TranspositionTable::clearBuckets() {
+    // one slice per search thread, every thread first-touches its own pages
+    int threads = std::max(1, Config::threads);
+    uint64_t slice = (numBuckets + threads - 1) / threads;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        uint64_t begin = std::min(numBuckets, t * slice);
+        uint64_t end = std::min(numBuckets, begin + slice);
+
+        workers.emplace_back([this, begin, end] {
+            // buckets only hold lock-free atomics, zero bytes are empty entries
+            std::memset(static_cast<void *>(buckets + begin), 0, (end - begin) * sizeof(Bucket));
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+int TranspositionTable::hashfull() const {
+    const uint64_t sampled = std::min<uint64_t>(1000 / BUCKET_SIZE, numBuckets);
+
+    int used = 0;
+    for (uint64_t i = 0; i < sampled; i++) {
+        for (auto &slot : buckets[i].entries) {
+            uint64_t data = slot.load(std::memory_order_relaxed);
+            used += data != 0 && entryGeneration(data) == generation;
+        }
+    }
+    return static_cast<int>(used * 1000 / (sampled * BUCKET_SIZE));
+}
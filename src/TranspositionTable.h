@@ -1,56 +1,197 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <iostream>
+#include <thread>
 #include "Move.h"
 #include "Config.h"
-#include "Metrics.h"
 #include "Common.h"
+#include "Metrics.h"
+
+// depths of quiescence search entries, below every main search entry
+const int DEPTH_QS_CHECKS = 0;      // in check, all evasions searched
+const int DEPTH_QS_NO_CHECKS = -1;  // good captures only
+
+// mate scores are stored as plies from the entry's position, search scores count them from the root
+inline int valueToTT(int value, int ply) {
+    return value >= MATE_BOUND ? value + ply : value <= -MATE_BOUND ? value - ply : value;
+}
+inline int valueFromTT(int value, int ply) {
+    return value >= MATE_BOUND ? value - ply : value <= -MATE_BOUND ? value + ply : value;
+}
 
-template<typename T>
+struct SearchEntry {
+    uint64_t zobristKey = 0;
+    int depth = 0;
+    int value = 0;
+    int bound = 0;
+    Move bestMove;
+};
+
+/**
+ * Lock-free transposition table shared by all search threads.
+ * Entries are packed into single 64-bit atomic words, 8 per 64-byte bucket, so a probe can never see
+ * a half-written entry. The bucket is picked by the high key bits (multiply-shift, any table size works),
+ * the low 16 bits are kept as a tag.
+ *
+ * Memory is mapped lazily (huge pages on Linux) and first touched by the clearing threads, which run in the
+ * background for clear() and resize(). wait() has to be called before the table is used again.
+ */
 class TranspositionTable {
  public:
-    int N;
-    TranspositionTable() {
-        N = getNumEntriesNeeded();
-        Metric<TT_ENTRIES>::set(N);
-        entries = new T[N];
+    static constexpr int BUCKET_SIZE = 8;
+
+    explicit TranspositionTable(int megabytes = Config::transpositionTableSize);
+    ~TranspositionTable();
+
+    // called once per go, entries of older searches are the first to be replaced
+    void newSearch() {
+        generation = (generation + 1) & GENERATION_MASK;
+    }
+
+    bool probe(uint64_t key, SearchEntry &entry) {
+        Bucket &bucket = bucketOf(key);
+        uint64_t tag = key & 0xFFFF;
+
+        for (auto &slot : bucket.entries) {
+            uint64_t data = slot.load(std::memory_order_relaxed);
+            if (data == 0 || (data & 0xFFFF) != tag) continue;
+
+            // keep entries that are still useful in this search, unless another thread just replaced it
+            if (entryGeneration(data) != generation) {
+                uint64_t expected = data;
+                slot.compare_exchange_strong(expected, withGeneration(data, generation), std::memory_order_relaxed);
+            }
+            entry = unpack(key, data);
+            return true;
+        }
+        return false;
+    }
+
+    // start loading the bucket of a position that is about to be searched
+    void prefetch(uint64_t key) {
+        __builtin_prefetch(&bucketOf(key));
+    }
+
+    void store(uint64_t key, const SearchEntry &entry) {
+        Bucket &bucket = bucketOf(key);
+        uint64_t tag = key & 0xFFFF;
+
+        bool quiescence = entry.depth <= DEPTH_QS_CHECKS;
+
+        // same position, otherwise an empty slot, otherwise the shallowest / oldest entry
+        std::atomic<uint64_t> *replace = &bucket.entries[0];
+        int replaceScore = INT32_MAX;
+        bool otherPosition = true;
+        for (auto &slot : bucket.entries) {
+            uint64_t data = slot.load(std::memory_order_relaxed);
+            if (data == 0 || (data & 0xFFFF) == tag) {
+                // a deeper result of the current search is kept unless the new one is exact,
+                // quiescence results never replace main search ones of the same position
+                if (data != 0
+                    && entryGeneration(data) == generation
+                    && ((entry.bound != EXACT && entry.depth + 4 <= entryDepth(data))
+                        || (quiescence && entryDepth(data) > DEPTH_QS_CHECKS))) {
+                    return;
+                }
+                replace = &slot;
+                otherPosition = false;
+                break;
+            }
+
+            int age = (generation - entryGeneration(data)) & GENERATION_MASK;
+            int score = entryDepth(data) - 8 * age;
+            if (score < replaceScore) {
+                replaceScore = score;
+                replace = &slot;
+            }
+        }
+
+        // quiescence results are cheap to recompute, they only take slots of other quiescence or old entries
+        if (quiescence && otherPosition && replaceScore > DEPTH_QS_CHECKS) {
+            return;
+        }
+
+        replace->store(pack(tag, entry), std::memory_order_relaxed);
     }
-    ~TranspositionTable() {
-        delete[] entries;
+
+    // permille of sampled entries written in the current search
+    [[nodiscard]] int hashfull() const;
+
+    // both return immediately, the work is finished by wait()
+    void clear();
+    void resize();
+    void wait();
+
+    [[nodiscard]] uint64_t size() const { return numBuckets; }
+
+ private:
+    struct alignas(64) Bucket {
+        std::atomic<uint64_t> entries[BUCKET_SIZE]{};
+    };
+
+    // tag:16 | from:6 | to:6 | promotion:4 | value:16 | depth:8 | bound + 1:2 | generation:6
+    // squares are stored as 0-63, no move as from == to == 0, real moves never start and end on one square.
+    // The other move flags are not stored, the move has to be looked up in the generated moves before it is played
+    static constexpr int GENERATION_MASK = 63;
+    static_assert(MoveFlags::PROMOTION_SUBMASK == 15 << 4, "promotion flags have to fit the 4 promotion bits");
+
+    Bucket &bucketOf(uint64_t key) {
+        return buckets[static_cast<uint64_t>((static_cast<unsigned __int128>(key) * numBuckets) >> 64)];
     }
-    T &at(uint64_t key) {
-        return entries[key & (N - 1)];
+
+    [[nodiscard]] uint64_t pack(uint64_t tag, const SearchEntry &entry) const {
+        int value = std::max(EVAL_MIN, std::min(EVAL_MAX, entry.value));
+        const Move &move = entry.bestMove;
+        bool noMove = (move.flags & MoveFlags::NULL_MOVE) || move.from == move.to;
+        uint64_t packedMove = noMove ? 0 : square64(move.from)
+            | square64(move.to) << 6
+            | (move.flags & MoveFlags::PROMOTION_SUBMASK) >> 4 << 12;
+        return tag
+            | packedMove << 16
+            | static_cast<uint64_t>(static_cast<uint16_t>(value)) << 32
+            | static_cast<uint64_t>(static_cast<uint8_t>(entry.depth)) << 48
+            | static_cast<uint64_t>(entry.bound + 1) << 56
+            | static_cast<uint64_t>(generation) << 58;
     }
-    T &operator[](uint64_t key) {
-        return entries[key & (N - 1)];
+    static SearchEntry unpack(uint64_t key, uint64_t data) {
+        SearchEntry entry;
+        entry.zobristKey = key;
+        int from = square0x88(static_cast<int>(data >> 16) & 63);
+        int to = square0x88(static_cast<int>(data >> 22) & 63);
+        int promotion = (static_cast<int>(data >> 28) & 15) << 4;
+        entry.bestMove = from == to ? Move(0, 0, MoveFlags::NULL_MOVE) : Move(from, to, promotion);
+        entry.value = static_cast<int16_t>(data >> 32);
+        entry.depth = entryDepth(data);
+        entry.bound = static_cast<int>((data >> 56) & 3) - 1;
+        return entry;
     }
-    void store(uint64_t key, T value) {
-        entries[key & (N - 1)] = value;
+    static uint64_t square64(int square0x88) {
+        return static_cast<uint64_t>((square0x88 + (square0x88 & 7)) >> 1);
     }
-    void clear() {
-        for (int i = 0; i < N; i++) {
-            entries[i] = T{};
-        }
+    static int square0x88(int square64) {
+        return square64 + (square64 & ~7);
     }
-    void resize() {
-        delete[] entries;
-        N = getNumEntriesNeeded();
-        entries = new T[N];
-        Metric<TT_ENTRIES>::set(N);
+    static int entryDepth(uint64_t data) {
+        return static_cast<int8_t>(data >> 48);
     }
- private:
-    int getNumEntriesNeeded(){
-        uint64_t numEntries = Config::transpositionTableSize * 1000000LL / sizeof(T);
-        return (1 << (64 - __builtin_clzll(numEntries))); //make it into the smallest power of two for fast mod
+    static int entryGeneration(uint64_t data) {
+        return static_cast<int>(data >> 58);
+    }
+    static uint64_t withGeneration(uint64_t data, int gen) {
+        return (data & ~(static_cast<uint64_t>(GENERATION_MASK) << 58)) | static_cast<uint64_t>(gen) << 58;
     }
-    T *entries;
-};
 
-struct SearchEntry {
-    uint64_t zobristKey = 0;
-    int depth = 0;
-    int value = 0;
-    int bound = 0;
-    Move bestMove;
-};
\ No newline at end of file
+    void allocate(int megabytes);
+    void release();
+    void clearBuckets();
+
+    Bucket *buckets = nullptr;
+    uint64_t numBuckets = 0;
+    size_t allocatedBytes = 0;
+    bool mapped = false; // mmap instead of aligned_alloc, fresh mappings are already zero
+    int generation = 0;
+    std::thread pending;
+};
@@ -7,6 +7,16 @@
 #include "Board.h"
 #include "Metrics.h"
 #include "Config.h"
+#include "NnueKernels.h"
+
+// check options that switch search features on and off
+static const std::array<std::pair<std::string, bool *>, 5> SEARCH_TOGGLES = {{
+    {"LateMoveReductions", &Config::lateMoveReductions},
+    {"FutilityPruning", &Config::futilityPruning},
+    {"ReverseFutilityPruning", &Config::reverseFutilityPruning},
+    {"LateMovePruning", &Config::lateMovePruning},
+    {"AdaptiveNullMove", &Config::adaptiveNullMove},
+}};
 
 Board UCI::parsePosition(const std::vector<std::string> &tokens) {
     auto getBoard = [&] {
@@ -36,7 +46,7 @@ Board UCI::parsePosition(const std::vector<std::string> &tokens) {
             bool foundLegal = false;
             for (int j = 0; j < moveGenerator.size() && !foundLegal; j++) {
                 if (Board::moveToString(moveGenerator[j]) == *move) {
-                    board.makeMove(moveGenerator[j]);
+                    board.playMove(moveGenerator[j]);
                     foundLegal = true;
                 }
             }
@@ -73,25 +83,64 @@ SearchParams UCI::parseGo(const std::vector<std::string> &tokens) {
         params.depthLimit = std::stoi(*std::next(depthToken));
     }
 
+    auto getValue = [&](const std::string &name) -> long long {
+        auto token = std::find(tokens.begin(), tokens.end(), name);
+        return token == tokens.end() || std::next(token) == tokens.end() ? 0 : std::stoll(*std::next(token));
+    };
+    params.whiteTime = getValue("wtime");
+    params.blackTime = getValue("btime");
+    params.whiteIncrement = getValue("winc");
+    params.blackIncrement = getValue("binc");
+    params.movesToGo = (int) getValue("movestogo");
+    params.mateLimit = (int) getValue("mate");
+    params.infinite = std::find(tokens.begin(), tokens.end(), "infinite") != tokens.end();
+    params.ponder = std::find(tokens.begin(), tokens.end(), "ponder") != tokens.end();
+
     return params;
 }
 
-void UCI::sendInfo(int depth, int eval, const Move &best, double time) {
-    auto nodesSearched =
-        Metric<NODES_SEARCHED>::get() + Metric<Q_NODES_SEARCHED>::get() - Metric<LEAF_NODES_SEARCHED>::get();
+void UCI::sendInfo(const SearchInfo &info) {
     std::cout << "info ";
-    std::cout << "depth " << depth << " ";
-    std::cout << "score cp " << eval << " ";
-    std::cout << "pv " << Board::moveToString(best) << " ";
-    std::cout << "nodes " << nodesSearched << " ";
-    std::cout << "nps " << (int) (nodesSearched / time) << " ";
-    std::cout << "time " << (int) (time * 1000) << " ";
-    std::cout << "hashfull " << (1000 * Metric<TT_WRITTEN>::get() / Metric<TT_ENTRIES>::get()) << " ";
+    std::cout << "depth " << info.depth << " ";
+    std::cout << "seldepth " << info.selDepth << " ";
+    std::cout << "multipv " << info.multiPv << " ";
+    if (isMateScore(info.eval)) {
+        // full moves, negative when getting mated
+        int plies = EVAL_MAX - std::abs(info.eval);
+        std::cout << "score mate " << (info.eval > 0 ? (plies + 1) / 2 : -(plies / 2)) << " ";
+    } else {
+        std::cout << "score cp " << info.eval << " ";
+    }
+    if (info.bound == LOWER_BOUND) {
+        std::cout << "lowerbound ";
+    } else if (info.bound == UPPER_BOUND) {
+        std::cout << "upperbound ";
+    }
+    std::cout << "nodes " << info.nodes << " ";
+    std::cout << "nps " << (long long) (info.nodes / info.time) << " ";
+    std::cout << "time " << (int) (info.time * 1000) << " ";
+    std::cout << "hashfull " << info.hashfull << " ";
+    std::cout << "pv";
+    for (const auto &move : info.pv) {
+        std::cout << " " << Board::moveToString(move);
+    }
     std::cout << std::endl;
 }
 
-void UCI::sendResult(const Move &bestMove) {
-    std::cout << "bestmove " << Board::moveToString(bestMove) << std::endl;
+void UCI::sendMetrics(const Metrics::Snapshot &metrics) {
+    std::cout << "info string metrics";
+    std::cout << " leafnodes " << metrics[LEAF_NODES_SEARCHED];
+    std::cout << " qnodes " << metrics[Q_NODES_SEARCHED];
+    std::cout << " tthits " << metrics[CACHE_HITS];
+    std::cout << std::endl;
+}
+
+void UCI::sendResult(const Move &bestMove, const Move &ponderMove) {
+    std::cout << "bestmove " << Board::moveToString(bestMove);
+    if (Config::ponder && !(ponderMove.flags & MoveFlags::NULL_MOVE)) {
+        std::cout << " ponder " << Board::moveToString(ponderMove);
+    }
+    std::cout << std::endl;
 }
 
 void UCI::sendOptions() {
@@ -99,29 +148,67 @@ void UCI::sendOptions() {
     std::cout << "option name UCI_Variant type combo default atomic var atomic" << std::endl;
 
     // Hash size
-    std::cout << "option name Hash type spin default " << Config::transpositionTableSize << " min 1 max 1024"
+    std::cout << "option name Hash type spin default " << Config::transpositionTableSize << " min 1 max " << MAX_HASH
+              << std::endl;
+
+    // Search threads
+    std::cout << "option name Threads type spin default " << Config::threads << " min 1 max " << MAX_THREADS
+              << std::endl;
+
+    // Search on the opponent's time
+    std::cout << "option name Ponder type check default " << (Config::ponder ? "true" : "false") << std::endl;
+
+    // Time kept back for communication delays
+    std::cout << "option name Move Overhead type spin default " << Config::moveOverhead << " min 0 max 5000"
               << std::endl;
 
+    // Number of principal variations reported
+    std::cout << "option name MultiPV type spin default " << Config::multiPv << " min 1 max " << MAX_MULTI_PV
+              << std::endl;
+
+    // Pruning and reductions
+    for (auto &[name, enabled] : SEARCH_TOGGLES) {
+        std::cout << "option name " << name << " type check default " << (*enabled ? "true" : "false") << std::endl;
+    }
+
     // Evaluation type
     std::cout << "option name EvalType type combo default FULL var FULL var SIMPLE" << std::endl;
 
     // NNUE path
-    std::cout << "option name NNUEPath type string default <empty>" << std::endl;
+    std::cout << "option name NNUEPath type string default "
+              << (Config::nnuePath.empty() ? "<empty>" : Config::nnuePath) << std::endl;
 }
 
 void UCI::setOption(
     const std::vector<std::string> &tokens
 ) {
-    if (tokens.size() != 5 || tokens[1] != "name" || tokens[3] != "value") {
-        std::cout << "Unrecognized setoption command";
+    // option names may contain spaces
+    auto valueToken = std::find(tokens.begin(), tokens.end(), "value");
+    if (tokens.size() < 5 || tokens[1] != "name" || valueToken == tokens.end() || std::next(valueToken) == tokens.end()) {
+        std::cout << "Unrecognized setoption command" << std::endl;
         return;
     }
 
-    const auto &option = tokens[2];
-    const auto &value = tokens[4];
+    std::string option = tokens[2];
+    for (auto token = tokens.begin() + 3; token != valueToken; token++) {
+        option += " " + *token;
+    }
+    const auto &value = *std::next(valueToken);
 
     if (option == "Hash") {
-        Config::transpositionTableSize = std::stoi(value);
+        Config::transpositionTableSize = std::clamp(std::stoi(value), 1, MAX_HASH);
+    } else if (option == "Threads") {
+        Config::threads = std::clamp(std::stoi(value), 1, MAX_THREADS);
+    } else if (option == "Ponder") {
+        Config::ponder = value == "true";
+    } else if (option == "Move Overhead") {
+        Config::moveOverhead = std::clamp(std::stoi(value), 0, 5000);
+    } else if (option == "MultiPV") {
+        Config::multiPv = std::clamp(std::stoi(value), 1, MAX_MULTI_PV);
+    } else if (auto toggle = std::find_if(SEARCH_TOGGLES.begin(), SEARCH_TOGGLES.end(),
+                                          [&](const auto &t) { return t.first == option; });
+               toggle != SEARCH_TOGGLES.end()) {
+        *toggle->second = value == "true";
     } else if (option == "NNUEPath") {
         Config::nnuePath = value == "<empty>" ? "" : value;
     } else if (option == "EvalType") {
@@ -138,6 +225,7 @@ void UCI::uciOk() {
     std::cout << "uciok" << std::endl;
 }
 void UCI::engineInfo() {
-    std::cout << "id name BoomChess" << std::endl;
+    // instruction set of the NNUE kernels picked for this cpu
+    std::cout << "id name BoomChess (" << NNUE::Kernels::active().name << ")" << std::endl;
     std::cout << "id author Martynas Cibulskis" << std::endl;
 }
@@ -2,13 +2,28 @@
 
 #include <vector>
 #include "Board.h"
+#include "Metrics.h"
+
+// one line of search output
+struct SearchInfo {
+    int depth;
+    int selDepth;
+    int multiPv;
+    int eval;
+    const std::vector<Move> &pv;
+    long long nodes;
+    double time;
+    int hashfull;
+    int bound = EXACT; // aspiration fails report the score as a bound
+};
 
 class UCI {
  public:
     static Board parsePosition(const std::vector<std::string> &tokens);
     static SearchParams parseGo(const std::vector<std::string> &tokens);
-    static void sendInfo(int depth, int eval, const Move &best, double time);
-    static void sendResult(const Move &bestMove);
+    static void sendInfo(const SearchInfo &info);
+    static void sendMetrics(const Metrics::Snapshot &metrics);
+    static void sendResult(const Move &bestMove, const Move &ponderMove);
     static void sendOptions();
     static void setOption(const std::vector<std::string> &tokens);
     static void uciOk();
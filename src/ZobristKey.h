@@ -10,7 +10,9 @@ class ZobristKey {
 
  public:
     ZobristKey() {
-        generateNumbers();
+        // random numbers are shared by all keys, generate them once
+        static const bool generated = (generateNumbers(), true);
+        (void) generated;
     }
 
     uint64_t value = 0;
@@ -33,9 +35,9 @@ class ZobristKey {
     }
 
  private:
-    std::array<std::array<std::array<uint64_t, 128>, 10>, 2> pieceNumbers{}; //[color][type][index]
-    std::array<uint64_t, 2> moveColorNumbers{};
-    std::array<uint64_t, 8> enPassantFileNumbers{};
-    std::array<std::array<uint64_t, 4>, 2> castlingRightNumbers{}; //[color][right]
-    void generateNumbers();
+    static inline std::array<std::array<std::array<uint64_t, 128>, 10>, 2> pieceNumbers{}; //[color][type][index]
+    static inline std::array<uint64_t, 2> moveColorNumbers{};
+    static inline std::array<uint64_t, 8> enPassantFileNumbers{};
+    static inline std::array<std::array<uint64_t, 4>, 2> castlingRightNumbers{}; //[color][right]
+    static void generateNumbers();
 };
@@ -1,50 +1,314 @@
+#include <cstring>
+#include <sstream>
 #include "nnue.h"
 
+#ifdef EMBEDDED_NNUE
+// network given to cmake with -DEMBED_NNUE, linked in as raw bytes
+#ifdef _WIN32
+#define EMBEDDED_NNUE_SECTION ".section .rdata\n"
+#else
+#define EMBEDDED_NNUE_SECTION ".section .rodata\n"
+#endif
+asm(EMBEDDED_NNUE_SECTION
+    ".balign 64\n"
+    ".global embeddedNnueBegin\n"
+    "embeddedNnueBegin:\n"
+    ".incbin \"" EMBEDDED_NNUE "\"\n"
+    ".global embeddedNnueEnd\n"
+    "embeddedNnueEnd:\n"
+    ".text\n");
+extern "C" const char embeddedNnueBegin[];
+extern "C" const char embeddedNnueEnd[];
+#endif
+
 namespace NNUE {
 
-    void NNUE::loadNetwork(const std::string &fileName) {
-        std::ifstream fileStream(fileName);
-        layer_1.load(fileStream, Q_FACTOR, Q_FACTOR);
-        layer_2.load(fileStream, Q_FACTOR, Q_FACTOR * Q_FACTOR);
-        layer_3.load(fileStream, Q_FACTOR, Q_FACTOR * Q_FACTOR);
+    namespace {
+        template<typename ARCH>
+        bool matches(int l1Size, int l2Size) {
+            return ARCH::L1_SIZE == l1Size && ARCH::L2_SIZE == l2Size;
+        }
+
+        std::unique_ptr<Network> readBinaryNetwork(std::istream &stream) {
+            char magic[sizeof(NETWORK_MAGIC)]{};
+            uint32_t header[4]{};
+            stream.read(magic, sizeof(magic));
+            stream.read(reinterpret_cast<char *>(header), sizeof(header));
+            if (!stream || std::memcmp(magic, NETWORK_MAGIC, sizeof(magic)) != 0 || header[0] != NETWORK_VERSION) {
+                return nullptr;
+            }
+
+            int inputSize = static_cast<int>(header[1]);
+            int l1Size = static_cast<int>(header[2]);
+            int l2Size = static_cast<int>(header[3]);
+
+            auto read = [&](auto network) -> std::unique_ptr<Network> {
+                if (inputSize != network->INPUT_SIZE || !network->readBinary(stream)) return nullptr;
+                return network;
+            };
+
+            if (matches<Architecture128>(l1Size, l2Size)) return read(std::make_unique<NNUE<Architecture128>>());
+            if (matches<Architecture256>(l1Size, l2Size)) return read(std::make_unique<NNUE<Architecture256>>());
+            if (matches<Architecture512>(l1Size, l2Size)) return read(std::make_unique<NNUE<Architecture512>>());
+            return nullptr;
+        }
+
+        // the trainer's text format has no header, layer sizes follow from the number of values per line
+        std::unique_ptr<Network> readTextNetwork(std::istream &stream) {
+            auto countValues = [](const std::string &line) {
+                std::istringstream lineStream(line);
+                int count = 0;
+                std::string value;
+                while (lineStream >> value) count++;
+                return count;
+            };
+
+            std::string text((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+            std::istringstream lines(text);
+            std::string line;
+
+            // L1 rows of input weights, then L1 biases, then L2 rows of 2 * L1 weights
+            int l1Size = 0;
+            while (std::getline(lines, line) && countValues(line) == Architecture128::INPUT_SIZE) l1Size++;
+            int l2Size = 0;
+            while (std::getline(lines, line) && countValues(line) == l1Size * 2) l2Size++;
+
+            auto load = [&](auto network) -> std::unique_ptr<Network> {
+                std::istringstream values(text);
+                if (!network->loadText(values)) return nullptr;
+                return network;
+            };
+
+            if (matches<Architecture128>(l1Size, l2Size)) return load(std::make_unique<NNUE<Architecture128>>());
+            if (matches<Architecture256>(l1Size, l2Size)) return load(std::make_unique<NNUE<Architecture256>>());
+            if (matches<Architecture512>(l1Size, l2Size)) return load(std::make_unique<NNUE<Architecture512>>());
+            return nullptr;
+        }
+    }
+
+    std::unique_ptr<Network> loadNetwork(const std::string &fileName) {
+        std::ifstream fileStream(fileName, std::ios::binary);
+        if (!fileStream) {
+            std::cout << "info string Could not open network " << fileName << std::endl;
+            return nullptr;
+        }
+
+        // binary networks start with a magic, otherwise it is the trainer's text format
+        char magic[sizeof(NETWORK_MAGIC)]{};
+        fileStream.read(magic, sizeof(magic));
+        bool binary = fileStream && std::memcmp(magic, NETWORK_MAGIC, sizeof(magic)) == 0;
+        fileStream.clear();
+        fileStream.seekg(0);
+
+        auto network = binary ? readBinaryNetwork(fileStream) : readTextNetwork(fileStream);
+        if (!network) {
+            std::cout << "info string Network " << fileName << " has an unsupported architecture" << std::endl;
+        }
+        return network;
+    }
+
+    std::unique_ptr<Network> loadEmbeddedNetwork() {
+#ifdef EMBEDDED_NNUE
+        std::istringstream stream(std::string(embeddedNnueBegin, embeddedNnueEnd - embeddedNnueBegin));
+        auto network = readBinaryNetwork(stream);
+        if (!network) {
+            std::cout << "info string Embedded network is not compatible" << std::endl;
+        }
+        return network;
+#else
+        return nullptr;
+#endif
+    }
+
+    bool hasEmbeddedNetwork() {
+#ifdef EMBEDDED_NNUE
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    template<typename ARCH>
+    bool NNUE<ARCH>::loadText(std::istream &stream) {
+        layers->layer_1.load(stream, Q_FACTOR, Q_FACTOR);
+        layers->layer_2.load(stream, Q_FACTOR, Q_FACTOR * Q_FACTOR);
+        layers->layer_3.load(stream, Q_FACTOR, Q_FACTOR * Q_FACTOR);
+        if (!stream) {
+            return false;
+        }
+
+        onNetworkLoaded();
+        return true;
+    }
+
+    template<typename ARCH>
+    bool NNUE<ARCH>::readBinary(std::istream &stream) {
+        layers->layer_1.read(stream);
+        layers->layer_2.read(stream);
+        layers->layer_3.read(stream);
+        if (!stream) {
+            return false;
+        }
 
-        accumulator.init();
+        onNetworkLoaded();
+        return true;
     }
 
-    int NNUE::evaluate(int sideToMove) {
+    template<typename ARCH>
+    void NNUE<ARCH>::save(const std::string &fileName) const {
+        std::ofstream fileStream(fileName, std::ios::binary);
+        uint32_t header[4] = {NETWORK_VERSION, INPUT_SIZE, L1_SIZE, L2_SIZE};
+
+        fileStream.write(NETWORK_MAGIC, sizeof(NETWORK_MAGIC));
+        fileStream.write(reinterpret_cast<const char *>(header), sizeof(header));
+        layers->layer_1.write(fileStream);
+        layers->layer_2.write(fileStream);
+        layers->layer_3.write(fileStream);
+    }
+
+    template<typename ARCH>
+    std::unique_ptr<Network> NNUE<ARCH>::clone() const {
+        return std::make_unique<NNUE<ARCH>>(*this);
+    }
+
+    template<typename ARCH>
+    std::string NNUE<ARCH>::architecture() const {
+        return std::to_string(INPUT_SIZE) + "x" + std::to_string(L1_SIZE) + "x" + std::to_string(L2_SIZE);
+    }
+
+    template<typename ARCH>
+    void NNUE<ARCH>::onNetworkLoaded() {
+        layers->layer_2_sparse.quantize(layers->layer_2);
+        for (int i = 0; i < L1_SIZE; i++) {
+            layers->layer_1_bias[i] = static_cast<QT>(layers->layer_1.bias[i]);
+        }
+        initAccumulator();
+    }
+
+    template<typename ARCH>
+    void NNUE<ARCH>::initAccumulator() {
+        accumulator.init(ply, layers->layer_1_bias);
+    }
+
+    template<typename ARCH>
+    void NNUE<ARCH>::applyStagedChanges(bool copy) {
+        accumulator.applyChanges(ply, staged, copy, layers->layer_1, *kernels);
+        staged.addedCount = 0;
+        staged.removedCount = 0;
+    }
+
+    template<typename ARCH>
+    int NNUE<ARCH>::evaluate(int sideToMove) {
+        return denseLayer2() ? evaluateDense(sideToMove) : evaluateSparse(sideToMove);
+    }
+
+    template<typename ARCH>
+    int NNUE<ARCH>::evaluateSparse(int sideToMove) {
+        // join the outputs of accumulators, clip them and squeeze into uint8
+        alignas(64) std::array<QTU8, L1_SIZE * 2> accumulators;
+
+        kernels->clipPack(accumulator.at(ply, sideToMove).data(), accumulators.data(), L1_SIZE);
+        kernels->clipPack(accumulator.at(ply, 1 - sideToMove).data(), accumulators.data() + L1_SIZE, L1_SIZE);
+
+        //apply second hidden layer, most of the inputs are zero after clipping
+        std::array<QT, L2_SIZE> outputLayer2;
+        applySparseLinear<L1_SIZE * 2, L2_SIZE>(layers->layer_2_sparse, accumulators, outputLayer2);
+
+        return evaluateOutput(outputLayer2);
+    }
+
+    template<typename ARCH>
+    int NNUE<ARCH>::evaluateDense(int sideToMove) {
         // join the outputs of accumulators
-        static std::array<QT, L1_SIZE * 2> accumulators;
+        std::array<QT, L1_SIZE * 2> accumulators;
 
         for (int i = 0; i < L1_SIZE; i++) {
-            accumulators[i] = accumulator[sideToMove][i];
-            accumulators[i + L1_SIZE] = accumulator[1 - sideToMove][i];
+            accumulators[i] = accumulator.at(ply, sideToMove)[i];
+            accumulators[i + L1_SIZE] = accumulator.at(ply, 1 - sideToMove)[i];
         }
 
         applyClippedReLU<L1_SIZE * 2>(accumulators);
 
         //apply second hidden layer
-        static std::array<QT, L2_SIZE> outputLayer2;
+        std::array<QT, L2_SIZE> outputLayer2;
+        applyLinear<L1_SIZE * 2, L2_SIZE>(layers->layer_2, accumulators, outputLayer2);
+
+        return evaluateOutput(outputLayer2);
+    }
+
+    template<typename ARCH>
+    void NNUE<ARCH>::evaluateBatch(const NetworkInput *inputs, int count, int *outputs) const {
+        alignas(64) std::array<std::array<QTU8, L1_SIZE * 2>, BATCH_SIZE> outputLayer1;
+        alignas(64) std::array<QT, L1_SIZE> acc;
+        std::array<QT, L1_SIZE * 2> denseLayer1;
+        std::array<const QT *, 32> rows;
+        std::array<std::array<QT, L2_SIZE>, BATCH_SIZE> outputLayer2;
+        std::array<std::array<QT, 1>, BATCH_SIZE> outputLayer3;
 
-        applyLinear<L1_SIZE * 2, L2_SIZE>(layer_2, accumulators, outputLayer2);
+        for (int start = 0; start < count; start += BATCH_SIZE) {
+            int size = std::min(BATCH_SIZE, count - start);
+
+            // build the accumulators from scratch, clipped and squeezed like in evaluate
+            for (int b = 0; b < size; b++) {
+                const auto &input = inputs[start + b];
+                for (int perspective = 0; perspective < 2; perspective++) {
+                    const auto &features = perspective == 0 ? input.us : input.them;
+
+                    for (int f = 0; f < input.count; f++) {
+                        rows[f] = layers->layer_1.weights[features[f]].data();
+                    }
+                    kernels->updateRows(layers->layer_1_bias.data(), acc.data(), rows.data(), input.count, nullptr, 0, L1_SIZE);
+                    if (denseLayer2()) {
+                        std::copy(acc.begin(), acc.end(), denseLayer1.begin() + perspective * L1_SIZE);
+                    } else {
+                        kernels->clipPack(acc.data(), outputLayer1[b].data() + perspective * L1_SIZE, L1_SIZE);
+                    }
+                }
+
+                // same layer as evaluate picks
+                if (denseLayer2()) {
+                    applyClippedReLU<L1_SIZE * 2>(denseLayer1);
+                    applyLinear<L1_SIZE * 2, L2_SIZE>(layers->layer_2, denseLayer1, outputLayer2[b]);
+                }
+            }
+
+            if (!denseLayer2()) {
+                applySparseLinearBatch<L1_SIZE * 2, L2_SIZE>(layers->layer_2_sparse, outputLayer1.data(), outputLayer2.data(), size);
+            }
+            for (int b = 0; b < size; b++) {
+                applyClippedReLU<L2_SIZE>(outputLayer2[b]);
+            }
+
+            applyLinearBatch<L2_SIZE, 1>(layers->layer_3, outputLayer2.data(), outputLayer3.data(), size);
+            for (int b = 0; b < size; b++) {
+                outputs[start + b] = static_cast<int>(outputLayer3[b][0]) * 100 / Q_FACTOR;
+            }
+        }
+    }
+
+    template<typename ARCH>
+    int NNUE<ARCH>::evaluateOutput(std::array<QT, L2_SIZE> &outputLayer2) const {
         applyClippedReLU<L2_SIZE>(outputLayer2);
 
         //apply final layer
-        static std::array<QT, 1> outputLayer3;
-        applyLinear<L2_SIZE, 1>(layer_3, outputLayer2, outputLayer3);
+        std::array<QT, 1> outputLayer3;
+        applyLinear<L2_SIZE, 1>(layers->layer_3, outputLayer2, outputLayer3);
 
         return static_cast<int>(outputLayer3[0]) * 100 / Q_FACTOR;
     }
 
+    template<typename ARCH>
     template<int N>
-    void NNUE::applyClippedReLU(std::array<QT, N> &input) {
+    void NNUE<ARCH>::applyClippedReLU(std::array<QT, N> &input) const {
         for (int i = 0; i < N; i++) {
             input[i] = std::min(std::max(input[i], static_cast<QT>(0)), static_cast<QT>(Q_FACTOR));
         }
     }
 
+    template<typename ARCH>
     template<int N, int M>
-    void NNUE::applyLinear(const LinearLayer<N, M> &layer, std::array<QT, N> &input, std::array<QT, M> &output) {
-        static std::array<QTO, M> outputBig;
+    void NNUE<ARCH>::applyLinear(const LinearLayer<N, M> &layer, std::array<QT, N> &input, std::array<QT, M> &output) const {
+        std::array<QTO, M> outputBig;
 
         std::copy(layer.bias.begin(), layer.bias.end(), outputBig.begin());
 
@@ -59,4 +323,74 @@ namespace NNUE {
         }
     }
 
+    template<typename ARCH>
+    template<int N, int M>
+    void NNUE<ARCH>::applySparseLinear(const SparseLinearLayer<N, M> &layer,
+                                       const std::array<QTU8, N> &input,
+                                       std::array<QT, M> &output) const {
+        // indices of non-zero 4-byte input chunks
+        std::array<uint16_t, N / 4> nonZero;
+        alignas(64) std::array<QTO, M> outputBig;
+
+        int nonZeroCount = kernels->findNonZero(input.data(), N, nonZero.data());
+
+        std::copy(layer.bias.begin(), layer.bias.end(), outputBig.begin());
+        kernels->sparseAccumulate(layer.weights.data(), input.data(), nonZero.data(), nonZeroCount, outputBig.data(), M);
+
+        for (int j = 0; j < M; j++) {
+            output[j] = static_cast<QT>(outputBig[j] >> Q8_OUTPUT_SHIFT);
+        }
+    }
+
+    template<typename ARCH>
+    template<int N, int M>
+    void NNUE<ARCH>::applySparseLinearBatch(const SparseLinearLayer<N, M> &layer,
+                                            const std::array<QTU8, N> *input,
+                                            std::array<QT, M> *output,
+                                            int count) const {
+        // positions go through in tiles that share every weight load
+        alignas(64) std::array<std::array<QTO, M>, BATCH_SIZE> outputBig;
+        for (int b = 0; b < count; b++) {
+            std::copy(layer.bias.begin(), layer.bias.end(), outputBig[b].begin());
+        }
+
+        kernels->sparseAccumulateBatch(layer.weights.data(), input[0].data(), N, count, outputBig[0].data(), M);
+
+        for (int b = 0; b < count; b++) {
+            for (int j = 0; j < M; j++) {
+                output[b][j] = static_cast<QT>(outputBig[b][j] >> Q8_OUTPUT_SHIFT);
+            }
+        }
+    }
+
+    template<typename ARCH>
+    template<int N, int M>
+    void NNUE<ARCH>::applyLinearBatch(const LinearLayer<N, M> &layer,
+                                const std::array<QT, N> *input,
+                                std::array<QT, M> *output,
+                                int count) const {
+        std::array<std::array<QTO, M>, BATCH_SIZE> outputBig;
+        for (int b = 0; b < count; b++) {
+            std::copy(layer.bias.begin(), layer.bias.end(), outputBig[b].begin());
+        }
+
+        for (int i = 0; i < N; i++) {
+            for (int b = 0; b < count; b++) {
+                for (int j = 0; j < M; j++) {
+                    outputBig[b][j] += input[b][i] * layer.weights[i][j];
+                }
+            }
+        }
+
+        for (int b = 0; b < count; b++) {
+            for (int j = 0; j < M; j++) {
+                output[b][j] = outputBig[b][j] / Q_FACTOR;
+            }
+        }
+    }
+
+    template class NNUE<Architecture128>;
+    template class NNUE<Architecture256>;
+    template class NNUE<Architecture512>;
+
 }
@@ -1,30 +1,56 @@
 #pragma once
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
-#include <immintrin.h>
 #include <fstream>
 #include <iostream>
 #include "Common.h"
+#include "NnueKernels.h"
 
 namespace NNUE {
-    constexpr int INPUT_SIZE = 768;
-    constexpr int L1_SIZE = 128;
-    constexpr int L2_SIZE = 32;
     constexpr int Q_FACTOR = 256;
     using QT = int16_t;
     using QTO = int32_t;
 
+    // int8 quantization of the second layer
+    constexpr int Q8_INPUT_SHIFT = 1;      // clipped activations [0, Q_FACTOR] -> [0, 127]
+    constexpr int Q8_WEIGHT_SCALE = 64;    // weights in [-2, 2) fit int8
+    constexpr int Q8_OUTPUT_SHIFT = 5;     // (Q_FACTOR >> 1) * 64 / Q_FACTOR = 2^5
+    using QT8 = int8_t;
+    using QTU8 = uint8_t;
+
+    // binary network format: magic, version, layer sizes, then quantized layers
+    constexpr char NETWORK_MAGIC[8] = {'B', 'O', 'O', 'M', 'N', 'N', 'U', 'E'};
+    constexpr uint32_t NETWORK_VERSION = 1;
+
+    /**
+     * ARCHITECTURE
+     * (INPUT_SIZE -> L1_SIZE) * 2 -> L2_SIZE -> 1
+     */
+    template<int L1, int L2>
+    struct Architecture {
+        static constexpr int INPUT_SIZE = 768;
+        static constexpr int L1_SIZE = L1;
+        static constexpr int L2_SIZE = L2;
+    };
+
+    // architectures compiled into the engine, the loader picks one by the network's layer sizes
+    using Architecture128 = Architecture<128, 32>;
+    using Architecture256 = Architecture<256, 32>;
+    using Architecture512 = Architecture<512, 32>;
+
     /**
      * LINEAR LAYER
      */
     template<int INPUT_N, int OUTPUT_N>
     class LinearLayer {
      public:
-        std::array<QTO, OUTPUT_N> bias{};
-        std::array<std::array<QT, OUTPUT_N>, INPUT_N> weights{}; //[IN][OUT]
-        void load(std::ifstream &fileStream, int weightScale, int biasScale) {
+        alignas(64) std::array<QTO, OUTPUT_N> bias{};
+        alignas(64) std::array<std::array<QT, OUTPUT_N>, INPUT_N> weights{}; //[IN][OUT]
+        void load(std::istream &fileStream, int weightScale, int biasScale) {
             for (int i = 0; i < OUTPUT_N; i++) {
                 for (int j = 0; j < INPUT_N; j++) {
                     double w;
@@ -40,104 +66,251 @@ namespace NNUE {
                 bias[i] = static_cast<QTO>(w * biasScale);
             }
         }
+        void read(std::istream &stream) {
+            stream.read(reinterpret_cast<char *>(weights.data()), sizeof(weights));
+            stream.read(reinterpret_cast<char *>(bias.data()), sizeof(bias));
+        }
+        void write(std::ostream &stream) const {
+            stream.write(reinterpret_cast<const char *>(weights.data()), sizeof(weights));
+            stream.write(reinterpret_cast<const char *>(bias.data()), sizeof(bias));
+        }
+    };
+
+    // feature indices of a piece from white's and black's perspective
+    inline std::pair<int, int> featureIndices(int square0x88, int piece, int color) {
+        int square = (square0x88 + (square0x88 & 7)) >> 1;
+        int featureWhite = square * 12 + (piece - 1) * 2 + color;
+        int featureBlack = (square ^ 56) * 12 + (piece - 1) * 2 + (1 - color);
+        return std::make_pair(featureWhite, featureBlack);
+    }
+
+    /**
+     * SPARSE INT8 LINEAR LAYER
+     * Weights are stored in blocks of 4 inputs so that every non-zero 4-byte input chunk
+     * contributes to all outputs with one multiply-add per vector of outputs
+     */
+    template<int INPUT_N, int OUTPUT_N>
+    class SparseLinearLayer {
+     public:
+        static_assert(INPUT_N % 64 == 0 && OUTPUT_N % 16 == 0 && OUTPUT_N <= 128);
+
+        alignas(64) std::array<QTO, OUTPUT_N> bias{};
+        alignas(64) std::array<QT8, INPUT_N * OUTPUT_N> weights{}; //[IN / 4][OUT][4]
+
+        void quantize(const LinearLayer<INPUT_N, OUTPUT_N> &layer) {
+            constexpr int weightDiv = Q_FACTOR / Q8_WEIGHT_SCALE;
+            constexpr int biasDiv = Q_FACTOR * Q_FACTOR / (Q8_WEIGHT_SCALE * (Q_FACTOR >> Q8_INPUT_SHIFT));
+
+            for (int i = 0; i < INPUT_N; i++) {
+                for (int j = 0; j < OUTPUT_N; j++) {
+                    int w = layer.weights[i][j];
+                    int rounded = (w + (w >= 0 ? weightDiv / 2 : -weightDiv / 2)) / weightDiv;
+                    weights[((i / 4) * OUTPUT_N + j) * 4 + i % 4] = static_cast<QT8>(std::clamp(rounded, -127, 127));
+                }
+            }
+            for (int j = 0; j < OUTPUT_N; j++) {
+                bias[j] = layer.bias[j] / biasDiv;
+            }
+        }
+    };
+
+    /**
+     * STAGED FEATURE CHANGES
+     * (white, black) feature pairs collected during a move, applied to the accumulator at once
+     */
+    struct FeatureChanges {
+        std::array<std::pair<int, int>, 64> added{};
+        std::array<std::pair<int, int>, 64> removed{};
+        int addedCount = 0;
+        int removedCount = 0;
     };
 
     /**
      * ACCUMULATOR
      */
-    template<int MAX_PLY, int WIDTH>
+    template<typename ARCH, int MAX_PLY>
     class NnueAccumulator {
      public:
-        explicit NnueAccumulator(LinearLayer<INPUT_SIZE, L1_SIZE> *layer_1) : layer_1(layer_1) {};
+        static constexpr int WIDTH = ARCH::L1_SIZE;
+        static_assert(WIDTH % 32 == 0);
 
-        template<bool REMOVE_PIECE>
-        void stageChange(int square0x88, int piece, int color) {
-            int square = (square0x88 + (square0x88 & 7)) >> 1;
-            int featureWhite = square * 12 + (piece - 1) * 2 + color;
-            int featureBlack = (square ^ 56) * 12 + (piece - 1) * 2 + (1 - color);
-            auto update = std::make_pair(featureWhite, featureBlack);
+        void init(int ply, const std::array<QT, WIDTH> &bias) {
+            accumulator[ply][WHITE] = bias;
+            accumulator[ply][BLACK] = bias;
+        }
+        void applyChanges(int ply,
+                          const FeatureChanges &changes,
+                          bool copy,
+                          const LinearLayer<ARCH::INPUT_SIZE, WIDTH> &layer_1,
+                          const Kernels::KernelSet &kernels) {
+            std::array<const QT *, 64> added;
+            std::array<const QT *, 64> removed;
 
-            if (!REMOVE_PIECE) {
-                stagingNewFeatures[newIdx++] = update;
-            } else {
-                stagingDelFeatures[delIdx++] = update;
+            for (int color : {WHITE, BLACK}) {
+                for (int f = 0; f < changes.addedCount; f++) {
+                    auto &feature = changes.added[f];
+                    added[f] = layer_1.weights[color == WHITE ? feature.first : feature.second].data();
+                }
+                for (int f = 0; f < changes.removedCount; f++) {
+                    auto &feature = changes.removed[f];
+                    removed[f] = layer_1.weights[color == WHITE ? feature.first : feature.second].data();
+                }
+
+                const QT *source = copy ? accumulator[ply - 1][color].data() : accumulator[ply][color].data();
+                kernels.updateRows(source, accumulator[ply][color].data(),
+                                   added.data(), changes.addedCount,
+                                   removed.data(), changes.removedCount,
+                                   WIDTH);
             }
         }
 
-        void init(){
-            for(int i = 0; i < L1_SIZE; i++){
-                accumulator[ply][WHITE][i] = static_cast<QT>(layer_1->bias[i]);
-                accumulator[ply][BLACK][i] = static_cast<QT>(layer_1->bias[i]);
-            }
+        std::array<QT, WIDTH> &at(int ply, int stm) {
+            return accumulator[ply][stm];
         }
-        void applyStagedChanges(bool copy = true) {
-            if (copy)
-                for (int color : {WHITE, BLACK}) {
-                    std::copy(accumulator[ply - 1][color].begin(),
-                              accumulator[ply - 1][color].end(),
-                              accumulator[ply][color].begin());
-                }
 
-            for (int f = 0; f < newIdx; f++) {
-                auto &feature = stagingNewFeatures[f];
-                for (int i = 0; i < WIDTH; i++) {
+     private:
+        alignas(64) std::array<std::array<std::array<QT, WIDTH>, 2>, MAX_PLY> accumulator{};
+    };
 
-                    accumulator[ply][WHITE][i] += layer_1->weights[feature.first][i];
-                    accumulator[ply][BLACK][i] += layer_1->weights[feature.second][i];
-                }
-            }
+    /**
+     * BATCH INPUT
+     * Active features of a position from the side to move's (us) and the opponent's (them) perspective
+     */
+    struct NetworkInput {
+        std::array<uint16_t, 32> us{};
+        std::array<uint16_t, 32> them{};
+        int count = 0;
 
-            for (int f = 0; f < delIdx; f++) {
-                auto &feature = stagingDelFeatures[f];
-                for (int i = 0; i < WIDTH; i++) {
-                    accumulator[ply][WHITE][i] -= layer_1->weights[feature.first][i];
-                    accumulator[ply][BLACK][i] -= layer_1->weights[feature.second][i];
-                }
-            }
+        void addPiece(int square0x88, int piece, int color, int sideToMove) {
+            auto features = featureIndices(square0x88, piece, color);
+            us[count] = static_cast<uint16_t>(sideToMove == WHITE ? features.first : features.second);
+            them[count] = static_cast<uint16_t>(sideToMove == WHITE ? features.second : features.first);
+            count++;
+        }
+    };
+
+    /**
+     * NETWORK
+     * Architecture independent interface used by the board and search,
+     * piece changes are staged here and handed to the concrete network once per move
+     */
+    class Network {
+     public:
+        virtual ~Network() = default;
+
+        template<bool REMOVE_PIECE>
+        void stageChange(int square0x88, int piece, int color) {
+            auto update = featureIndices(square0x88, piece, color);
 
-            delIdx = 0;
-            newIdx = 0;
+            if (!REMOVE_PIECE) {
+                staged.added[staged.addedCount++] = update;
+            } else {
+                staged.removed[staged.removedCount++] = update;
+            }
         }
 
         void increaseDepth() { ply++; }
         void decreaseDepth() { ply--; }
         void setDepth(int depth) { ply = depth; }
 
-        std::array<QT, WIDTH> &operator[](int stm) {
-            return accumulator[ply][stm];
-        }
-        int ply = 0;
-     private:
+        // defaults to the best instruction set of this cpu
+        void setKernels(const Kernels::KernelSet &kernelSet) { kernels = &kernelSet; }
+
+        virtual void initAccumulator() = 0;
+        virtual void applyStagedChanges(bool copy = true) = 0;
+        // sparse int8 second layer, dense on the scalar kernels which are slower at the sparse one
+        virtual int evaluate(int sideToMove) = 0;
+        virtual int evaluateSparse(int sideToMove) = 0;
+        virtual int evaluateDense(int sideToMove) = 0;
+        virtual void evaluateBatch(const NetworkInput *inputs, int count, int *outputs) const = 0;
+        virtual void save(const std::string &fileName) const = 0;
+        [[nodiscard]] virtual std::string architecture() const = 0;
 
-        int newIdx = 0;
-        int delIdx = 0;
+        // copy with its own accumulators, weights are shared (one per search thread)
+        [[nodiscard]] virtual std::unique_ptr<Network> clone() const = 0;
+
+     protected:
+        int ply = 0;
+        FeatureChanges staged;
+        const Kernels::KernelSet *kernels = &Kernels::active();
 
-        LinearLayer<INPUT_SIZE, L1_SIZE> *layer_1;
-        std::array<std::array<std::array<QT, WIDTH>, 2>, MAX_PLY> accumulator{};
-        std::array<std::pair<int, int>, 64> stagingNewFeatures{};
-        std::array<std::pair<int, int>, 64> stagingDelFeatures{};
+        // without vector registers the strided int8 dot products cost more than the whole dense layer
+        [[nodiscard]] bool denseLayer2() const { return kernels == &Kernels::scalar; }
     };
 
     /**
      * NNUE
      */
-    class NNUE {
+    template<typename ARCH>
+    class NNUE : public Network {
      public:
-        NNUE() : accumulator(&layer_1) {}
-        void loadNetwork(const std::string &fileName);
-        int evaluate(int sideToMove);
-        NnueAccumulator<MAX_DEPTH, L1_SIZE> accumulator;
+        static constexpr int INPUT_SIZE = ARCH::INPUT_SIZE;
+        static constexpr int L1_SIZE = ARCH::L1_SIZE;
+        static constexpr int L2_SIZE = ARCH::L2_SIZE;
+
+        bool loadText(std::istream &stream);
+        bool readBinary(std::istream &stream);
+
+        void initAccumulator() override;
+        void applyStagedChanges(bool copy) override;
+        int evaluate(int sideToMove) override;
+        int evaluateSparse(int sideToMove) override;
+        int evaluateDense(int sideToMove) override;
+        void evaluateBatch(const NetworkInput *inputs, int count, int *outputs) const override;
+        void save(const std::string &fileName) const override;
+        [[nodiscard]] std::string architecture() const override;
+        [[nodiscard]] std::unique_ptr<Network> clone() const override;
 
      private:
-        LinearLayer<INPUT_SIZE, L1_SIZE> layer_1{};
-        LinearLayer<L1_SIZE * 2, L2_SIZE> layer_2{};
-        LinearLayer<L2_SIZE, 1> layer_3{};
+        static constexpr int BATCH_SIZE = 64;
+
+        // read-only once loaded, shared between clones
+        struct Layers {
+            LinearLayer<INPUT_SIZE, L1_SIZE> layer_1{};
+            LinearLayer<L1_SIZE * 2, L2_SIZE> layer_2{};
+            LinearLayer<L2_SIZE, 1> layer_3{};
+            SparseLinearLayer<L1_SIZE * 2, L2_SIZE> layer_2_sparse{};
+            alignas(64) std::array<QT, L1_SIZE> layer_1_bias{};
+        };
+
+        std::shared_ptr<Layers> layers = std::make_shared<Layers>();
+        NnueAccumulator<ARCH, MAX_DEPTH> accumulator;
+
+        void onNetworkLoaded();
+
+        int evaluateOutput(std::array<QT, L2_SIZE> &outputLayer2) const;
 
         template<int N>
-        void applyClippedReLU(std::array<QT, N> &input);
+        void applyClippedReLU(std::array<QT, N> &input) const;
+
+        template<int N, int M>
+        void applySparseLinear(const SparseLinearLayer<N, M> &layer,
+                               const std::array<QTU8, N> &input,
+                               std::array<QT, M> &output) const;
+
+        template<int N, int M>
+        void applySparseLinearBatch(const SparseLinearLayer<N, M> &layer,
+                                    const std::array<QTU8, N> *input,
+                                    std::array<QT, M> *output,
+                                    int count) const;
 
         template<int N, int M>
-        void applyLinear(const LinearLayer<N, M> &layer, std::array<QT, N> &input, std::array<QT, M> &output);
+        void applyLinear(const LinearLayer<N, M> &layer, std::array<QT, N> &input, std::array<QT, M> &output) const;
+
+        template<int N, int M>
+        void applyLinearBatch(const LinearLayer<N, M> &layer,
+                              const std::array<QT, N> *input,
+                              std::array<QT, M> *output,
+                              int count) const;
     };
 
+    extern template class NNUE<Architecture128>;
+    extern template class NNUE<Architecture256>;
+    extern template class NNUE<Architecture512>;
+
+    // loaders pick the architecture from the network, nullptr if the file is unusable
+    std::unique_ptr<Network> loadNetwork(const std::string &fileName);
+    std::unique_ptr<Network> loadEmbeddedNetwork();
+    bool hasEmbeddedNetwork();
+
 }